@@ -0,0 +1,144 @@
+// BeatClock.h
+#pragma once
+#include <JuceHeader.h>
+#include <cmath>
+
+// Beat position of every sample in the next block, from the host transport.
+// The ramp advances at the host tempo and wraps at the loop end inside the
+// block. While the host position follows the ramp of the previous block
+// (tempo ramps only make it drift), the next block starts where the last one
+// ended and steers back onto the host position, so the curve has no steps.
+// A larger difference is a jump and the clock resyncs to the host.
+// Without a playing transport the clock keeps running from where it is, at
+// the last known tempo, so the curve doesn't restart at 0 on every block.
+class BeatClock {
+public:
+	// Loops shorter than a block wrap several times; beyond this the ramp just continues
+	static constexpr int maxSegments = 16;
+	// Host position differences above this are jumps, smaller ones are tempo drift
+	static constexpr double jumpToleranceBeats = 1.0 / 64.0;
+
+	struct Segment {
+		int offset;
+		double startBeat;
+	};
+
+	void prepare(double newSampleRate) {
+		sampleRate = newSampleRate > 0.0 ? newSampleRate : 44100.0;
+		reset();
+	}
+
+	void reset() {
+		nextBeat = 0.0;
+		hasNext = false;
+		bpm = 120.0;
+		isPlaying = false;
+		increment = beatsPerSample(bpm);
+		numSegments = 1;
+		segments[0] = { 0, 0.0 };
+	}
+
+	// Reads the transport at the start of a block of numSamples
+	void advance(AudioPlayHead* playHead, int numSamples) {
+		Optional<double> hostBeat;
+		bool looping = false;
+		double loopStart = 0.0, loopEnd = 0.0;
+		isPlaying = false;
+
+		if (playHead != nullptr) {
+			if (auto position = playHead->getPosition()) {
+				bpm = jlimit(1.0, 1000.0, position->getBpm().orFallback(bpm));
+				isPlaying = position->getIsPlaying();
+				if (isPlaying)
+					hostBeat = position->getPpqPosition();
+
+				if (auto loop = position->getLoopPoints()) {
+					looping = position->getIsLooping() && loop->ppqEnd > loop->ppqStart;
+					loopStart = loop->ppqStart;
+					loopEnd = loop->ppqEnd;
+				}
+			}
+		}
+
+		increment = beatsPerSample(bpm);
+		double startBeat = hasNext ? nextBeat : 0.0;
+		double rate = increment;
+
+		if (hostBeat.hasValue()) {
+			const double error = *hostBeat - startBeat;
+			if (!hasNext || std::abs(error) > jumpToleranceBeats)
+				startBeat = *hostBeat;
+			else if (numSamples > 0)
+				rate += error / numSamples;
+		}
+		else {
+			// Free running, a loop would only confuse a stopped transport
+			looping = false;
+		}
+
+		fillSegments(startBeat, rate, numSamples, looping && startBeat < loopEnd, loopStart, loopEnd);
+		increment = rate;
+	}
+
+	double getBpm() const { return bpm; }
+	bool getIsPlaying() const { return isPlaying; }
+	// Beats per sample in this block, the same in every segment
+	double getIncrement() const { return increment; }
+
+	int getNumSegments() const { return numSegments; }
+	const Segment& getSegment(int index) const { return segments[index]; }
+
+	// Index of the segment that holds sample
+	int segmentAt(int sample) const {
+		int index = numSegments - 1;
+		while (index > 0 && segments[index].offset > sample)
+			--index;
+		return index;
+	}
+
+	double beatAt(int sample) const {
+		const auto& segment = segments[segmentAt(sample)];
+		return segment.startBeat + increment * (sample - segment.offset);
+	}
+
+	// First sample after sample where the ramp wraps, or numSamples
+	int segmentEnd(int sample, int numSamples) const {
+		const int index = segmentAt(sample);
+		return index + 1 < numSegments ? segments[index + 1].offset : numSamples;
+	}
+
+private:
+	double sampleRate = 44100.0;
+	double bpm = 120.0;
+	bool isPlaying = false;
+	double increment = 0.0;
+	double nextBeat = 0.0;
+	bool hasNext = false;
+	Segment segments[maxSegments];
+	int numSegments = 1;
+
+	double beatsPerSample(double tempo) const {
+		return tempo / 60.0 / sampleRate;
+	}
+
+	void fillSegments(double startBeat, double rate, int numSamples, bool looping, double loopStart, double loopEnd) {
+		numSegments = 1;
+		segments[0] = { 0, startBeat };
+
+		while (looping && rate > 0.0 && numSegments < maxSegments) {
+			const auto& last = segments[numSegments - 1];
+			// First sample at or past the loop end
+			const double untilEnd = std::ceil((loopEnd - last.startBeat) / rate);
+			const int wrap = last.offset + static_cast<int>(jlimit(1.0, static_cast<double>(numSamples), untilEnd));
+			if (wrap >= numSamples)
+				break;
+
+			const double beat = last.startBeat + rate * (wrap - last.offset);
+			segments[numSegments++] = { wrap, loopStart + (beat - loopEnd) };
+		}
+
+		const auto& last = segments[numSegments - 1];
+		nextBeat = last.startBeat + rate * (numSamples - last.offset);
+		hasNext = true;
+	}
+};
@@ -0,0 +1,71 @@
+// BlockSmoothedValue.h
+#pragma once
+#include <JuceHeader.h>
+#include <cmath>
+
+// Linear smoother like SmoothedValue<float>, but it hands out a whole block
+// of values at once instead of one value per call.
+class BlockSmoothedValue {
+	float current = 0.0f;
+	float target = 0.0f;
+	float step = 0.0f;
+	int countdown = 0;
+	int stepsToTarget = 0;
+
+	// 1, 2, 3, ... so a ramp is one multiply-add over the block
+	HeapBlock<float> indexRamp;
+	int maxBlockSize = 0;
+
+public:
+	void reset(double sampleRate, double rampLengthInSeconds) {
+		stepsToTarget = static_cast<int>(std::floor(rampLengthInSeconds * sampleRate));
+		setCurrentAndTargetValue(target);
+	}
+
+	void prepare(int blockSize) {
+		maxBlockSize = jmax(1, blockSize);
+		indexRamp.allocate(static_cast<size_t>(maxBlockSize), false);
+		for (int i = 0; i < maxBlockSize; ++i)
+			indexRamp[i] = static_cast<float>(i + 1);
+	}
+
+	void setCurrentAndTargetValue(float newValue) {
+		current = target = newValue;
+		countdown = 0;
+	}
+
+	void setTargetValue(float newValue) {
+		if (exactlyEqual(newValue, target))
+			return;
+
+		if (stepsToTarget <= 0) {
+			setCurrentAndTargetValue(newValue);
+			return;
+		}
+
+		target = newValue;
+		countdown = stepsToTarget;
+		step = (target - current) / static_cast<float>(countdown);
+	}
+
+	float getCurrentValue() const { return current; }
+	float getTargetValue() const { return target; }
+	bool isSmoothing() const { return countdown > 0; }
+
+	// Writes the next numSamples values to dest and advances by as many samples.
+	void fill(float* dest, int numSamples) {
+		jassert(numSamples <= maxBlockSize || countdown == 0);
+		const int rampSamples = jmin(numSamples, countdown, maxBlockSize);
+
+		if (rampSamples > 0) {
+			FloatVectorOperations::copyWithMultiply(dest, indexRamp.get(), step, rampSamples);
+			FloatVectorOperations::add(dest, current, rampSamples);
+
+			countdown -= rampSamples;
+			current = countdown > 0 ? current + step * static_cast<float>(rampSamples) : target;
+		}
+
+		if (rampSamples < numSamples)
+			FloatVectorOperations::fill(dest + rampSamples, current, numSamples - rampSamples);
+	}
+};
@@ -0,0 +1,85 @@
+// DelayCrossfade.h
+#pragma once
+#include <JuceHeader.h>
+#include <vector>
+
+// Hides a jump in the delay trajectory, e.g. when a program change swaps the
+// seed or Speed. Every chunk's delays are tracked per channel; start() then
+// continues the old trajectory from its last delay and slope, and apply()
+// blends from it into the new delays with a smoothstep over the fade.
+class DelayCrossfade {
+public:
+	void prepare(int channels) {
+		numChannels = jmax(1, channels);
+		last.assign(static_cast<size_t>(numChannels), 0.0f);
+		slope.assign(static_cast<size_t>(numChannels), 0.0f);
+		from.assign(static_cast<size_t>(numChannels), 0.0f);
+		fromSlope.assign(static_cast<size_t>(numChannels), 0.0f);
+		reset();
+	}
+
+	void reset() {
+		hasLast = false;
+		length = 0;
+		position = 0;
+	}
+
+	bool isActive() const { return position < length; }
+
+	// Fades from where the tracked delays were heading, over lengthSamples
+	void start(int lengthSamples) {
+		if (!hasLast || lengthSamples <= 0)
+			return;
+
+		from = last;
+		fromSlope = slope;
+		length = lengthSamples;
+		position = 0;
+	}
+
+	// Blends the delays of one channel for the current chunk, in place
+	void apply(int channel, float* delays, int numSamples) const {
+		const auto ch = static_cast<size_t>(jmin(channel, numChannels - 1));
+		const int count = jmin(numSamples, length - position);
+
+		for (int k = 0; k < count; ++k) {
+			const float step = static_cast<float>(position + k + 1);
+			const float x = step / static_cast<float>(length);
+			const float gain = x * x * (3.0f - 2.0f * x);
+			const float old = from[ch] + fromSlope[ch] * step;
+			delays[k] = old + gain * (delays[k] - old);
+		}
+	}
+
+	// After every channel of a chunk was applied
+	void advance(int numSamples) {
+		position = jmin(length, position + numSamples);
+	}
+
+	void track(int channel, const float* delays, int numSamples) {
+		if (numSamples <= 0)
+			return;
+
+		const auto ch = static_cast<size_t>(jmin(channel, numChannels - 1));
+		slope[ch] = numSamples > 1 ? delays[numSamples - 1] - delays[numSamples - 2]
+								   : (hasLast ? delays[0] - last[ch] : 0.0f);
+		last[ch] = delays[numSamples - 1];
+	}
+
+	// All channels followed the same delays
+	void trackAll(const float* delays, int numSamples) {
+		for (int ch = 0; ch < numChannels; ++ch)
+			track(ch, delays, numSamples);
+	}
+
+	// After every channel of a chunk was tracked
+	void tracked() { hasLast = true; }
+
+private:
+	int numChannels = 1;
+	std::vector<float> last, slope;
+	std::vector<float> from, fromSlope;
+	bool hasLast = false;
+	int length = 0;
+	int position = 0;
+};
@@ -0,0 +1,305 @@
+// DelayKernel.h
+#pragma once
+#include <JuceHeader.h>
+#include "Interpolators.h"
+#include "RingPool.h"
+
+// Block-based fractional delay line.
+// The whole block is written into the ring before it is read back, and the
+// read positions and interpolation weights are resolved once per sample and
+// shared by every channel.
+//
+// The ring is channel-interleaved: one frame holds every channel of a sample,
+// so a tap read fetches all channels from neighbouring memory. Frames are
+// padded to a multiple of the SIMD width once there are enough channels to
+// fill a register, and the taps are then accumulated across channels. Mono
+// and stereo instead accumulate across samples, like before.
+//
+// The ring holds a power of two frames so positions wrap with a mask. Its
+// memory comes from the process-wide RingPool and is kept across prepares
+// unless it has to grow. If it can't be had, prepare fails and the kernel
+// leaves the audio as it is until a prepare succeeds.
+class DelayKernel {
+	using SIMD = dsp::SIMDRegister<float>;
+	static constexpr int simdWidth = Interpolators::simdWidth;
+	static constexpr int maxTaps = Interpolators::WindowedSinc::numTaps;
+
+public:
+	// Interpolators read tapsAhead samples newer than the read position, so
+	// shorter delays are clamped to that. The owner shifts every delay by the
+	// selected interpolator's getLookahead through setDelayOffset and reports
+	// it as latency; Linear needs none.
+	static constexpr int maxLookahead = Interpolators::WindowedSinc::tapsAhead;
+
+	static int getLookahead(Interpolators::Type type) {
+		switch (type) {
+			case Interpolators::Type::lagrange: return Interpolators::Lagrange3::tapsAhead;
+			case Interpolators::Type::sinc:     return Interpolators::WindowedSinc::tapsAhead;
+			default:                            return Interpolators::Linear::tapsAhead;
+		}
+	}
+
+private:
+	// The first guardSize frames are mirrored behind the end of the ring,
+	// so reading numTaps consecutive frames never has to wrap.
+	static constexpr int guardSize = maxTaps - 1;
+
+	SharedResourcePointer<RingPool> pool;
+	RingPool::Block ringBlock;
+	float* ring = nullptr;
+	int numChannels = 0;
+	int frameStride = 0;
+	int ringSize = 0;
+	int ringMask = 0;
+	int writePos = 0;
+	int maxDelay = 0;
+	int maxBlockSize = 0;
+	float delayOffset = 0.0f;
+
+	// Scratch, every row SIMD aligned: [fraction | weights x maxTaps | gathered | accumulator | frame]
+	HeapBlock<float> scratchData;
+	HeapBlock<int> startIndex;
+	size_t scratchCapacity = 0;
+	int scratchStride = 0;
+	float* fraction = nullptr;
+	float* weights[maxTaps] {};
+	float* gathered = nullptr;
+	float* accumulator = nullptr;
+	float* frameOut = nullptr;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DelayKernel)
+
+	bool accumulatesAcrossChannels() const { return frameStride % simdWidth == 0; }
+
+	void writeBlock(const AudioBuffer<float>& buffer, int startSample, int numSamples, int channels) {
+		const float* const* src = buffer.getArrayOfReadPointers();
+		int pos = writePos;
+
+		for (int i = 0; i < numSamples; ++i) {
+			float* frame = ring + pos * frameStride;
+			for (int ch = 0; ch < channels; ++ch)
+				frame[ch] = src[ch][startSample + i];
+
+			pos = (pos + 1) & ringMask;
+		}
+
+		FloatVectorOperations::copy(ring + ringSize * frameStride, ring, guardSize * frameStride);
+	}
+
+	// Resolves the oldest tap and the fraction of every sample
+	template <typename Interpolator>
+	void resolve(const float* delays, int numSamples, int paddedLength) {
+		constexpr int oldestTap = Interpolator::numTaps - 1 - Interpolator::tapsAhead;
+		const float minDelaySamples = static_cast<float>(Interpolator::tapsAhead);
+		const float maxDelaySamples = static_cast<float>(maxDelay + maxLookahead);
+
+		for (int i = 0; i < numSamples; ++i) {
+			float delay = jlimit(minDelaySamples, maxDelaySamples, delays[i] + delayOffset);
+			int whole = static_cast<int>(delay);
+			fraction[i] = delay - static_cast<float>(whole);
+
+			startIndex[i] = (writePos + i - whole - oldestTap) & ringMask;
+		}
+		for (int i = numSamples; i < paddedLength; ++i) {
+			fraction[i] = 0.0f;
+			startIndex[i] = 0;
+		}
+	}
+
+	// Accumulates across samples, one channel at a time
+	template <typename Interpolator>
+	void readAcrossSamples(AudioBuffer<float>& buffer, int startSample, int numSamples, int paddedLength, int firstChannel, int endChannel) {
+		for (int ch = firstChannel; ch < endChannel; ++ch) {
+			const float* src = ring + ch;
+
+			for (int k = 0; k < Interpolator::numTaps; ++k) {
+				for (int i = 0; i < paddedLength; ++i)
+					gathered[i] = src[(startIndex[i] + k) * frameStride];
+
+				const float* w = weights[k];
+				for (int i = 0; i < paddedLength; i += simdWidth) {
+					auto tap = SIMD::fromRawArray(gathered + i) * SIMD::fromRawArray(w + i);
+					if (k > 0)
+						tap += SIMD::fromRawArray(accumulator + i);
+					tap.copyToRawArray(accumulator + i);
+				}
+			}
+
+			FloatVectorOperations::copy(buffer.getWritePointer(ch, startSample), accumulator, numSamples);
+		}
+	}
+
+	// Accumulates across channels, one sample at a time
+	template <typename Interpolator>
+	void readAcrossChannels(AudioBuffer<float>& buffer, int startSample, int numSamples, int channels) {
+		float* const* dest = buffer.getArrayOfWritePointers();
+
+		for (int i = 0; i < numSamples; ++i) {
+			const float* frame = ring + startIndex[i] * frameStride;
+
+			for (int group = 0; group < frameStride; group += simdWidth) {
+				auto sum = SIMD::fromRawArray(frame + group) * weights[0][i];
+				for (int k = 1; k < Interpolator::numTaps; ++k)
+					sum += SIMD::fromRawArray(frame + k * frameStride + group) * weights[k][i];
+				sum.copyToRawArray(frameOut + group);
+			}
+
+			for (int ch = 0; ch < channels; ++ch)
+				dest[ch][startSample + i] = frameOut[ch];
+		}
+	}
+
+	template <typename Interpolator, int FixedChannels>
+	void processChannels(const Interpolator& interpolator, AudioBuffer<float>& buffer, int startSample, int numSamples, const float* delays) {
+		const int channels = FixedChannels > 0 ? FixedChannels : jmin(buffer.getNumChannels(), numChannels);
+		const int paddedLength = (numSamples + simdWidth - 1) / simdWidth * simdWidth;
+		jassert(numSamples <= maxBlockSize);
+		jassert(channels <= numChannels);
+
+		// 1. Write the block into the ring
+		writeBlock(buffer, startSample, numSamples, channels);
+
+		// 2. Resolve the read positions once for all channels
+		resolve<Interpolator>(delays, numSamples, paddedLength);
+
+		// 3. Interpolation weights, one row per tap
+		interpolator.computeWeights(fraction, weights, paddedLength);
+
+		// 4. Gather every tap and accumulate
+		if (FixedChannels == 0 && accumulatesAcrossChannels())
+			readAcrossChannels<Interpolator>(buffer, startSample, numSamples, channels);
+		else
+			readAcrossSamples<Interpolator>(buffer, startSample, numSamples, paddedLength, 0, channels);
+
+		advance(numSamples);
+	}
+
+	// Every channel has its own delay, so positions and weights are resolved per channel
+	template <typename Interpolator>
+	void processChannelsSeparately(const Interpolator& interpolator, AudioBuffer<float>& buffer, int startSample, int numSamples, const float* const* delays) {
+		const int channels = jmin(buffer.getNumChannels(), numChannels);
+		const int paddedLength = (numSamples + simdWidth - 1) / simdWidth * simdWidth;
+		jassert(numSamples <= maxBlockSize);
+
+		writeBlock(buffer, startSample, numSamples, channels);
+
+		for (int ch = 0; ch < channels; ++ch) {
+			resolve<Interpolator>(delays[ch], numSamples, paddedLength);
+			interpolator.computeWeights(fraction, weights, paddedLength);
+			readAcrossSamples<Interpolator>(buffer, startSample, numSamples, paddedLength, ch, ch + 1);
+		}
+
+		advance(numSamples);
+	}
+
+	void advance(int numSamples) {
+		writePos = (writePos + numSamples) & ringMask;
+	}
+
+	template <typename Interpolator>
+	void processWith(const Interpolator& interpolator, AudioBuffer<float>& buffer, int startSample, int numSamples, const float* delays) {
+		switch (jmin(buffer.getNumChannels(), numChannels)) {
+			case 1:  processChannels<Interpolator, 1>(interpolator, buffer, startSample, numSamples, delays); break;
+			case 2:  processChannels<Interpolator, 2>(interpolator, buffer, startSample, numSamples, delays); break;
+			default: processChannels<Interpolator, 0>(interpolator, buffer, startSample, numSamples, delays); break;
+		}
+	}
+
+public:
+	DelayKernel() = default;
+
+	// Returns false if the memory couldn't be allocated
+	bool prepare(int channels, int maxDelaySamples, int blockSize) {
+		// Built on the message thread rather than on the first sinc block
+		Interpolators::WindowedSinc::get();
+
+		numChannels = jmax(1, channels);
+		frameStride = numChannels < simdWidth ? numChannels : (numChannels + simdWidth - 1) / simdWidth * simdWidth;
+		maxDelay = jmax(0, maxDelaySamples);
+		maxBlockSize = jmax(1, blockSize);
+		ringSize = nextPowerOfTwo(maxDelay + maxLookahead + maxTaps + maxBlockSize);
+		ringMask = ringSize - 1;
+
+		// Page aligned, so no SIMD alignment fix-up is needed
+		const size_t ringBytes = static_cast<size_t>((ringSize + guardSize) * frameStride) * sizeof(float);
+		if (ringBlock.getSize() < ringBytes)
+			ringBlock = pool->acquire(ringBytes);
+		ring = ringBlock.get<float>();
+
+		// Scratch also only grows
+		scratchStride = (maxBlockSize + simdWidth - 1) / simdWidth * simdWidth;
+		const int frameRow = (frameStride + simdWidth - 1) / simdWidth * simdWidth;
+		const size_t scratchSize = static_cast<size_t>((maxTaps + 3) * scratchStride + frameRow + simdWidth);
+		if (scratchCapacity < scratchSize) {
+			scratchData.allocate(scratchSize, true);
+			startIndex.allocate(static_cast<size_t>(scratchStride), true);
+			scratchCapacity = scratchData != nullptr && startIndex != nullptr ? scratchSize : 0;
+		}
+
+		if (ring == nullptr || scratchCapacity == 0) {
+			ring = nullptr;
+			return false;
+		}
+
+		fraction = SIMD::getNextSIMDAlignedPtr(scratchData.get());
+		for (int k = 0; k < maxTaps; ++k)
+			weights[k] = fraction + (k + 1) * scratchStride;
+		gathered = fraction + (maxTaps + 1) * scratchStride;
+		accumulator = gathered + scratchStride;
+		frameOut = accumulator + scratchStride;
+
+		reset();
+		return true;
+	}
+
+	bool isPrepared() const { return ring != nullptr; }
+
+	void reset() {
+		if (ring != nullptr)
+			FloatVectorOperations::clear(ring, (ringSize + guardSize) * frameStride);
+		writePos = 0;
+	}
+
+	int getMaximumDelay() const { return maxDelay; }
+
+	// Added to every delay: the lookahead, and anything that lines the output up
+	// with another path. The maximum delay given to prepare has to include all
+	// but maxLookahead of it.
+	void setDelayOffset(float samples) { delayOffset = jmax(0.0f, samples); }
+	float getDelayOffset() const { return delayOffset; }
+	int getMaximumBlockSize() const { return maxBlockSize; }
+
+	// Calls fn with the interpolator selected by type
+	template <typename Fn>
+	static void withInterpolator(Interpolators::Type type, Fn&& fn) {
+		switch (type) {
+			case Interpolators::Type::lagrange:
+				fn(Interpolators::Lagrange3 {});
+				break;
+			case Interpolators::Type::sinc:
+				fn(Interpolators::WindowedSinc::get());
+				break;
+			default:
+				fn(Interpolators::Linear {});
+				break;
+		}
+	}
+
+	// delays holds one delay in samples per sample of the block, shared by all channels.
+	void process(AudioBuffer<float>& buffer, int startSample, int numSamples, const float* delays, Interpolators::Type type) {
+		if (ring == nullptr)
+			return;
+		withInterpolator(type, [&] (const auto& interpolator) {
+			processWith(interpolator, buffer, startSample, numSamples, delays);
+		});
+	}
+
+	// delays[ch] holds the delays of channel ch.
+	void processPerChannel(AudioBuffer<float>& buffer, int startSample, int numSamples, const float* const* delays, Interpolators::Type type) {
+		if (ring == nullptr)
+			return;
+		withInterpolator(type, [&] (const auto& interpolator) {
+			processChannelsSeparately(interpolator, buffer, startSample, numSamples, delays);
+		});
+	}
+};
@@ -1,114 +1,226 @@
 #pragma once
 
 #include <JuceHeader.h>
-#include <vector>
 #include <algorithm>
 #include <cmath>
-#include "LookAndFeel.h"
-#include "Defer.h"
+#include "UiResources.h"
+#include "History.h"
+
+// Scrolling plot of the applied shift.
+// Pushed values go into a History mipmap, so the window can be zoomed from 1
+// to 64 bars and survives resizes; a redraw reads O(width) entries however
+// long the window is.
+// The plot is cached in an image: new columns scroll it left and only they
+// are drawn. The whole window is only redrawn while the limits move, after
+// a zoom or after a resize. The zero line and labels live in a second image
+// that is redrawn together with the limits.
+class Diagram : public Component, public SettableTooltipClient {
+	History history;
+
+	// Zoom in bars of 4 quarters, powers of two
+	static constexpr int minBars = 1;
+	static constexpr int maxBars = History::maxBeats / 4;
+	int visibleBars = 2;
+	// Columns completed at the last render; column c covers the buckets [c * b, (c + 1) * b)
+	int64 drawnColumns = 0;
+
+	SharedResourcePointer<UiResources> resources;
+	Image plot;
+	Image overlay;
+	int scale = 1;
+	bool plotDirty = true;
+	bool overlayDirty = true;
+	// Where the last drawn column ended, to join the next one to it
+	float lastY = 0.0f;
+	bool hasLast = false;
+
+	// Limits animate linearly over limitTime
+	static constexpr double limitTime = 200.0;
+	float fromMin = 0.0f, fromMax = 1.0f;
+	float toMin = 0.0f, toMax = 1.0f;
+	float currentMin = 0.0f, currentMax = 1.0f;
+	double limitStart = 0.0;
 
-class Diagram : public Component {
-	// Data storage: Use a circular buffer to avoid expensive vector erasures
-	std::vector<float> dataBuffer;
-	int writeIndex = 0;
-	int totalPoints = 0;
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Diagram)
 
-	SmoothedValue<float, ValueSmoothingTypes::Linear> smoothMin, smoothMax;
+	// History buckets per column, usually fractional
+	double bucketsPerColumn() const {
+		return visibleBars * 4.0 * History::bucketsPerBeat / jmax(1, getWidth());
+	}
 
-	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Diagram)
+	int64 completedColumns() const {
+		return static_cast<int64>(std::floor(static_cast<double>(history.size()) / bucketsPerColumn()));
+	}
 
-public:
-	Diagram() {
-		setOpaque(true);
-		smoothMin.reset(30, 0.2);
-		smoothMax.reset(30, 0.2);
-		smoothMin.setCurrentAndTargetValue(0);
-		smoothMax.setCurrentAndTargetValue(1);
+	float toY(float value) const {
+		const float h = static_cast<float>(getHeight());
+		return jlimit(0.0f, h, jmap(value, currentMin, currentMax, h - 2.0f, 2.0f));
 	}
 
-	void shift(const std::vector<float>& values) {
-		if (dataBuffer.empty()) return;
+	// Draws the columns [first, last) at their place with last at the right edge
+	void drawColumns(Graphics& g, int64 first, int64 last) {
+		const float w = static_cast<float>(getWidth());
+		const double b = bucketsPerColumn();
+		g.setColour(ModernTheme::mainAccent);
 
-		// Add new values to circular buffer
-		for (float v : values) {
-			dataBuffer[writeIndex] = v;
-			writeIndex = (writeIndex + 1) % dataBuffer.size();
-			totalPoints = std::min((int)dataBuffer.size(), totalPoints + 1);
+		for (int64 c = jmax<int64>(0, first); c < last; ++c) {
+			const auto start = static_cast<int64>(std::floor(static_cast<double>(c) * b));
+			const auto end = jmax(start + 1, static_cast<int64>(std::floor(static_cast<double>(c + 1) * b)));
+			const auto span = history.get(start, end);
+
+			// Older than the history, or before anything was played
+			if (span.isEmpty()) {
+				hasLast = false;
+				continue;
+			}
+
+			const float x = w - static_cast<float>(last - c);
+			const float yLow = toY(span.min);
+			const float yHigh = toY(span.max);
+
+			// Down to the column's min and up to its max, which is one point for a smooth curve
+			if (hasLast)
+				g.drawLine(x - 1.0f, lastY, x, yLow, 2.0f);
+			if (yHigh != yLow)
+				g.drawLine(x, yLow, x, yHigh, 2.0f);
+			lastY = yHigh;
+			hasLast = true;
 		}
 	}
 
-	void paint(Graphics& g) override {
-		auto bounds = getLocalBounds().toFloat();
-		g.fillAll(Colours::black);
-		defer {
-			drawOverlays(g, bounds);
-		};
-
-		if (totalPoints < 2) return;
-
-		// 1. Prepare the Path
-		Path graphPath;
-		graphPath.preallocateSpace(totalPoints * 3); // Optimization: avoid reallocs
-
-		float min = smoothMin.getCurrentValue();
-		float max = smoothMax.getCurrentValue();
-		float w = bounds.getWidth();
-		float h = bounds.getHeight();
-
-		// 2. Iterate through circular buffer to build path
-		// We start from the oldest point and go to the newest
-		for (int i = 0; i < totalPoints; ++i) {
-			// Calculate index in circular buffer
-			int bufferIdx = (writeIndex - totalPoints + i + (int)dataBuffer.size()) % (int)dataBuffer.size();
-
-			float x = w - (totalPoints - i);
-			float yVal = jmap(dataBuffer[bufferIdx], min, max, h - 2.0f, 2.0f);
-			float yPos = jlimit(0.0f, h, yVal);
-
-			if (i == 0)
-				graphPath.startNewSubPath(x, yPos);
-			else
-				graphPath.lineTo(x, yPos);
+	void renderPlot() {
+		Graphics g(plot);
+		g.addTransform(AffineTransform::scale(static_cast<float>(scale)));
+
+		const int64 completed = completedColumns();
+		const int64 newColumns = completed - drawnColumns;
+
+		if (plotDirty || newColumns >= getWidth() || newColumns < 0) {
+			g.fillAll(Colours::black);
+			hasLast = false;
+			drawColumns(g, completed - getWidth(), completed);
+		}
+		else {
+			// Scroll what is there and draw only the new columns
+			const int shift = static_cast<int>(newColumns);
+			plot.moveImageSection(0, 0, shift * scale, 0, plot.getWidth() - shift * scale, plot.getHeight());
+			g.setColour(Colours::black);
+			g.fillRect(getWidth() - shift, 0, shift, getHeight());
+			drawColumns(g, drawnColumns, completed);
 		}
 
-		// 3. Draw the Path (Stroking is usually faster than filling a complex shape)
-		g.setColour(ModernTheme::mainAccent);
-		g.strokePath(graphPath, PathStrokeType(2.0f, PathStrokeType::curved, PathStrokeType::rounded));
+		drawnColumns = completed;
+		plotDirty = false;
 	}
 
-	void drawOverlays(Graphics& g, Rectangle<float> bounds) {
+	void renderOverlay() {
+		overlay.clear(overlay.getBounds());
+		Graphics g(overlay);
+		g.addTransform(AffineTransform::scale(static_cast<float>(scale)));
+
+		auto bounds = getLocalBounds().toFloat();
 		float margin = 10.0f;
-		float zeroY = jmap(0.0f, smoothMin.getCurrentValue(), smoothMax.getCurrentValue(), bounds.getHeight(), 0.0f);
+		float zeroY = jmap(0.0f, currentMin, currentMax, bounds.getHeight(), 0.0f);
 
 		g.setColour(Colours::white.withAlpha(0.4f));
 		float dashPattern[] = { 4.0f, 4.0f };
 		g.drawDashedLine(Line<float>(0, zeroY, bounds.getWidth(), zeroY), dashPattern, 2, 1.0f);
 
 		g.setColour(Colours::white.withAlpha(0.7f));
-		g.setFont(14.0f);
-		g.drawText(String(smoothMax.getTargetValue(), 1) + " ms", margin, 2, 100, 20, Justification::topLeft);
-		g.drawText(String(smoothMin.getTargetValue(), 1) + " ms", margin, bounds.getHeight() - 22, 100, 20, Justification::bottomLeft);
+		g.setFont(resources->labelFont);
+		g.drawText(String(toMax, 1) + " ms", margin, 2, 100, 20, Justification::topLeft);
+		g.drawText(String(toMin, 1) + " ms", margin, bounds.getHeight() - 22, 100, 20, Justification::bottomLeft);
+		g.drawText(String(visibleBars) + (visibleBars == 1 ? " bar" : " bars"),
+				   bounds.getWidth() - 100 - margin, bounds.getHeight() - 22, 100, 20, Justification::bottomRight);
+
+		overlayDirty = false;
 	}
 
-	void updateSmoothing() {
-		if (smoothMin.isSmoothing() || smoothMax.isSmoothing()) {
-			smoothMin.getNextValue();
-			smoothMax.getNextValue();
+public:
+	Diagram() {
+		setOpaque(true);
+		setTooltip("Scroll to zoom between 1 and 64 bars.");
+	}
+
+	// Appends one telemetry bucket
+	void push(float min, float max) {
+		history.push(min, max);
+	}
+
+	// Renders what changed since the last call into the cached images.
+	// Returns false if nothing did, so the caller can skip the repaint.
+	bool update(double nowMs) {
+		if (plot.isNull())
+			return false;
+
+		if (currentMin != toMin || currentMax != toMax) {
+			const float progress = static_cast<float>(jlimit(0.0, 1.0, (nowMs - limitStart) / limitTime));
+			currentMin = fromMin + (toMin - fromMin) * progress;
+			currentMax = fromMax + (toMax - fromMax) * progress;
+			plotDirty = overlayDirty = true;
 		}
+
+		if (!plotDirty && !overlayDirty && completedColumns() == drawnColumns)
+			return false;
+
+		if (plotDirty || completedColumns() != drawnColumns)
+			renderPlot();
+		if (overlayDirty)
+			renderOverlay();
+		return true;
+	}
+
+	void paint(Graphics& g) override {
+		if (plot.isNull()) {
+			g.fillAll(Colours::black);
+			return;
+		}
+
+		auto bounds = getLocalBounds().toFloat();
+		g.drawImage(plot, bounds);
+		g.drawImage(overlay, bounds);
 	}
 
 	void setLimits(float min, float max) {
 		if (std::abs(max - min) < 0.001f) max = min + 0.1f;
-		smoothMin.setTargetValue(min);
-		smoothMax.setTargetValue(max);
+		if (min == toMin && max == toMax) return;
+
+		fromMin = currentMin;
+		fromMax = currentMax;
+		toMin = min;
+		toMax = max;
+		limitStart = Time::getMillisecondCounterHiRes();
+		overlayDirty = true;
+	}
+
+	void setVisibleBars(int bars) {
+		bars = jlimit(minBars, maxBars, bars);
+		if (bars == visibleBars) return;
+
+		visibleBars = bars;
+		plotDirty = overlayDirty = true;
+	}
+
+	int getVisibleBars() const { return visibleBars; }
+
+	void mouseWheelMove(const MouseEvent&, const MouseWheelDetails& wheel) override {
+		if (wheel.deltaY > 0.0f)
+			setVisibleBars(visibleBars / 2);
+		else if (wheel.deltaY < 0.0f)
+			setVisibleBars(visibleBars * 2);
 	}
 
 	void resized() override {
-		int w = getWidth();
-		if (w > 0) {
-			dataBuffer.assign(w, 0.0f); // Size buffer to match width
-			writeIndex = 0;
-			totalPoints = 0;
+		// The history doesn't depend on the width, only the images do
+		const int w = getWidth();
+		scale = jmax(1, roundToInt(Component::getApproximateScaleFactorForComponent(this)));
+		if (w > 0 && getHeight() > 0) {
+			plot = Image(Image::RGB, w * scale, getHeight() * scale, true);
+			overlay = Image(Image::ARGB, w * scale, getHeight() * scale, true);
+		}
+		else {
+			plot = overlay = Image();
 		}
+		plotDirty = overlayDirty = true;
 	}
 };
@@ -0,0 +1,303 @@
+// GrooveAnalyzer.h
+#pragma once
+#include <JuceHeader.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "GrooveMap.h"
+
+// Extracts a GrooveMap from reference audio at a known tempo.
+// Onsets come from a spectral-flux detector: the rise of the log-magnitude
+// spectrum from one frame to the next, summed over bins, with adaptive
+// peak picking. Every onset is snapped to the nearest grid slot and its
+// offset from it is kept; the median offset of all onsets is removed first,
+// so only the timing relative to the groove's own pulse remains.
+//
+// The audio is read a window at a time, mixed to mono, and the spectra of a
+// window are computed in batches of frames on a thread pool, so a whole song
+// takes seconds and only the flux of every frame is kept. Everything here
+// blocks, call it from a background thread or a tool.
+class GrooveAnalyzer {
+public:
+	struct Settings {
+		double bpm = 120.0;
+		// Where beat 0 of the reference is; below 0 the first onset is taken
+		double firstBeatSeconds = -1.0;
+		int patternBeats = 4;
+		// 0 uses every core
+		int numThreads = 0;
+	};
+
+	struct Result {
+		GrooveMap map;
+		int numOnsets = 0;
+	};
+
+	// Returns an error message, or an empty string on success.
+	// Stops early with an error once cancel is set.
+	static String analyzeFile(const File& file, const Settings& settings, Result& result, const std::atomic<bool>* cancel = nullptr) {
+		AudioFormatManager formats;
+		formats.registerBasicFormats();
+
+		std::unique_ptr<AudioFormatReader> reader(formats.createReaderFor(file));
+		if (reader == nullptr)
+			return "cannot read " + file.getFullPathName();
+
+		AudioBuffer<float> window(jmax(1, static_cast<int>(reader->numChannels)), 0);
+		return analyzeSource(reader->lengthInSamples, reader->sampleRate, settings, result, cancel,
+			[&] (float* mono, int64 start, int numSamples) {
+				window.setSize(window.getNumChannels(), numSamples, false, false, true);
+				reader->read(&window, 0, numSamples, start, true, true);
+				mixDown(window, 0, mono, numSamples);
+			});
+	}
+
+	static String analyze(const AudioBuffer<float>& audio, double sampleRate, const Settings& settings, Result& result, const std::atomic<bool>* cancel = nullptr) {
+		return analyzeSource(audio.getNumSamples(), sampleRate, settings, result, cancel,
+			[&] (float* mono, int64 start, int numSamples) {
+				mixDown(audio, static_cast<int>(start), mono, numSamples);
+			});
+	}
+
+private:
+	static constexpr int framesPerBatch = 512;
+	// Batches per worker in one window of audio
+	static constexpr int batchesPerWindow = 4;
+	// Log compression of the magnitudes, so quiet hits count too
+	static constexpr float compression = 100.0f;
+
+	// Fills mono[0, numSamples) from the samples of the reference starting at start
+	using MonoReader = std::function<void(float* mono, int64 start, int numSamples)>;
+
+	static void mixDown(const AudioBuffer<float>& audio, int start, float* mono, int numSamples) {
+		FloatVectorOperations::clear(mono, numSamples);
+		for (int ch = 0; ch < audio.getNumChannels(); ++ch)
+			FloatVectorOperations::addWithMultiply(mono, audio.getReadPointer(ch, start), 1.0f / audio.getNumChannels(), numSamples);
+	}
+
+	// The frames of one window: mono starts at frame monoFrame, flux is filled for [first, last)
+	struct Window {
+		const float* mono = nullptr;
+		int monoFrame = 0;
+		int first = 0;
+		int last = 0;
+		std::atomic<int> nextBatch { 0 };
+		float* flux = nullptr;
+		const std::atomic<bool>* cancel = nullptr;
+	};
+
+	// Takes batches of the current window until none are left. Every worker
+	// owns its FFT and buffers and is added to the pool again for each window.
+	class FluxWorker : public ThreadPoolJob {
+		Window& window;
+		const int order;
+		const int hop;
+		const int frameSize;
+		const int numBins;
+		dsp::FFT fft;
+		dsp::WindowingFunction<float> hann;
+		std::vector<float> fftData;
+		std::vector<float> previous;
+
+		void spectrum(int frame) {
+			std::copy_n(window.mono + (frame - window.monoFrame) * hop, frameSize, fftData.data());
+			hann.multiplyWithWindowingTable(fftData.data(), static_cast<size_t>(frameSize));
+			fft.performFrequencyOnlyForwardTransform(fftData.data(), true);
+			for (int bin = 0; bin < numBins; ++bin)
+				fftData[static_cast<size_t>(bin)] = std::log1p(compression * fftData[static_cast<size_t>(bin)]);
+		}
+
+	public:
+		FluxWorker(Window& w, int fftOrder, int hopSize)
+			: ThreadPoolJob("Groove flux"), window(w), order(fftOrder), hop(hopSize),
+			  frameSize(1 << fftOrder), numBins(frameSize / 2 + 1), fft(fftOrder),
+			  hann(static_cast<size_t>(frameSize), dsp::WindowingFunction<float>::hann, false),
+			  fftData(static_cast<size_t>(frameSize * 2)), previous(static_cast<size_t>(numBins)) {}
+
+		JobStatus runJob() override {
+			const int numBatches = (window.last - window.first + framesPerBatch - 1) / framesPerBatch;
+
+			for (int batch = window.nextBatch++; batch < numBatches; batch = window.nextBatch++) {
+				if (shouldExit() || (window.cancel != nullptr && window.cancel->load()))
+					break;
+
+				const int first = window.first + batch * framesPerBatch;
+				const int last = jmin(window.last, first + framesPerBatch);
+
+				// The frame before the batch is only needed as the previous spectrum
+				spectrum(jmax(window.monoFrame, first - 1));
+				std::copy_n(fftData.data(), numBins, previous.data());
+
+				for (int frame = jmax(1, first); frame < last; ++frame) {
+					spectrum(frame);
+					float sum = 0.0f;
+					for (int bin = 0; bin < numBins; ++bin) {
+						const float current = fftData[static_cast<size_t>(bin)];
+						sum += jmax(0.0f, current - previous[static_cast<size_t>(bin)]);
+						previous[static_cast<size_t>(bin)] = current;
+					}
+					window.flux[frame] = sum;
+				}
+			}
+			return jobHasFinished;
+		}
+	};
+
+	static String analyzeSource(int64 numSamples, double sampleRate, const Settings& settings, Result& result,
+								const std::atomic<bool>* cancel, const MonoReader& read) {
+		if (settings.bpm <= 0.0 || sampleRate <= 0.0)
+			return "the tempo and sample rate must be positive";
+
+		// About 23 ms frames at any rate, four hops per frame
+		const int order = sampleRate <= 48000.0 ? 10 : (sampleRate <= 96000.0 ? 11 : 12);
+		const int frameSize = 1 << order;
+		const int hop = frameSize / 4;
+
+		const int64 frames = numSamples >= frameSize ? (numSamples - frameSize) / hop + 1 : 0;
+		if (frames > std::numeric_limits<int>::max())
+			return "the reference is too long";
+		const int numFrames = static_cast<int>(frames);
+		if (numFrames < 3)
+			return "the reference is too short";
+
+		std::vector<float> flux(static_cast<size_t>(numFrames), 0.0f);
+		computeFlux(order, hop, numFrames, settings.numThreads, flux, cancel, read);
+		if (cancel != nullptr && cancel->load())
+			return "cancelled";
+
+		std::vector<double> onsets;
+		pickOnsets(flux, hop, frameSize, sampleRate, onsets);
+		if (onsets.empty())
+			return "no onsets found";
+
+		buildMap(onsets, settings, result.map);
+		result.numOnsets = static_cast<int>(onsets.size());
+		return {};
+	}
+
+	// flux[f] is the summed rise of frame f over frame f - 1
+	static void computeFlux(int order, int hop, int numFrames, int numThreads, std::vector<float>& flux,
+							const std::atomic<bool>* cancel, const MonoReader& read) {
+		const int frameSize = 1 << order;
+		const int totalBatches = (numFrames + framesPerBatch - 1) / framesPerBatch;
+		const int threads = jlimit(1, totalBatches, numThreads > 0 ? numThreads : SystemStats::getNumCpus());
+		const int framesPerWindow = framesPerBatch * batchesPerWindow * threads;
+
+		Window window;
+		window.flux = flux.data();
+		window.cancel = cancel;
+		std::vector<float> mono(static_cast<size_t>(framesPerWindow * hop + frameSize));
+
+		std::vector<std::unique_ptr<FluxWorker>> workers;
+		for (int i = 0; i < threads; ++i)
+			workers.push_back(std::make_unique<FluxWorker>(window, order, hop));
+		// Declared after the workers, so it is gone before them
+		ThreadPool pool(threads);
+
+		for (int first = 0; first < numFrames; first += framesPerWindow) {
+			if (cancel != nullptr && cancel->load())
+				return;
+
+			// From the frame before the window, its first frame needs a previous spectrum
+			window.monoFrame = jmax(0, first - 1);
+			window.first = first;
+			window.last = jmin(numFrames, first + framesPerWindow);
+			window.nextBatch = 0;
+			read(mono.data(), static_cast<int64>(window.monoFrame) * hop, (window.last - 1 - window.monoFrame) * hop + frameSize);
+			window.mono = mono.data();
+
+			for (auto& worker : workers)
+				pool.addJob(worker.get(), false);
+			for (auto& worker : workers)
+				pool.waitForJobToFinish(worker.get(), -1);
+		}
+	}
+
+	// Local maxima that clear the moving average by a margin, in seconds
+	static void pickOnsets(const std::vector<float>& flux, int hop, int frameSize, double sampleRate, std::vector<double>& onsets) {
+		const int numFrames = static_cast<int>(flux.size());
+		const double framesPerSecond = sampleRate / hop;
+		// Peaks closer than 30 ms are one onset; the threshold follows 100 ms around
+		const int peakRadius = jmax(1, roundToInt(0.03 * framesPerSecond));
+		const int meanRadius = jmax(peakRadius, roundToInt(0.1 * framesPerSecond));
+		const float minimum = 0.05f * *std::max_element(flux.begin(), flux.end());
+
+		// Running sum for the moving average
+		std::vector<double> sums(static_cast<size_t>(numFrames + 1), 0.0);
+		for (int f = 0; f < numFrames; ++f)
+			sums[static_cast<size_t>(f + 1)] = sums[static_cast<size_t>(f)] + flux[static_cast<size_t>(f)];
+
+		for (int f = 1; f < numFrames - 1; ++f) {
+			const float value = flux[static_cast<size_t>(f)];
+			if (value <= minimum)
+				continue;
+
+			const int lo = jmax(0, f - meanRadius), hi = jmin(numFrames, f + meanRadius + 1);
+			const double mean = (sums[static_cast<size_t>(hi)] - sums[static_cast<size_t>(lo)]) / (hi - lo);
+			if (value < 1.5 * mean)
+				continue;
+
+			bool isPeak = true;
+			for (int g = jmax(0, f - peakRadius); g <= jmin(numFrames - 1, f + peakRadius) && isPeak; ++g)
+				isPeak = g == f || flux[static_cast<size_t>(g)] < value || (flux[static_cast<size_t>(g)] == value && g > f);
+			if (!isPeak)
+				continue;
+
+			// Parabolic interpolation between the neighbouring frames
+			const float a = flux[static_cast<size_t>(f - 1)], c = flux[static_cast<size_t>(f + 1)];
+			const float curvature = a - 2.0f * value + c;
+			const double shift = curvature < 0.0f ? 0.5 * (a - c) / curvature : 0.0;
+
+			onsets.push_back(((f + shift) * hop + frameSize / 2) / sampleRate);
+		}
+	}
+
+	static float median(std::vector<float>& values) {
+		auto middle = values.begin() + static_cast<std::ptrdiff_t>(values.size() / 2);
+		std::nth_element(values.begin(), middle, values.end());
+		return *middle;
+	}
+
+	static void buildMap(const std::vector<double>& onsets, const Settings& settings, GrooveMap& map) {
+		const int patternBeats = jlimit(1, GrooveMap::maxBeats, settings.patternBeats);
+		const int numSlots = patternBeats * GrooveMap::slotsPerBeat;
+		const double beatsPerSecond = settings.bpm / 60.0;
+		const double firstBeat = settings.firstBeatSeconds >= 0.0 ? settings.firstBeatSeconds : onsets.front();
+
+		auto slotPosition = [&] (double seconds) {
+			return (seconds - firstBeat) * beatsPerSecond * GrooveMap::slotsPerBeat;
+		};
+
+		// Align to the reference's own pulse first, then measure against it
+		std::vector<float> all;
+		for (auto onset : onsets) {
+			const double position = slotPosition(onset);
+			all.push_back(static_cast<float>(position - std::round(position)));
+		}
+		const double alignment = median(all);
+
+		std::vector<std::vector<float>> perSlot(static_cast<size_t>(numSlots));
+		for (auto onset : onsets) {
+			const double position = slotPosition(onset) - alignment;
+			const double nearest = std::round(position);
+			int slot = static_cast<int>(static_cast<int64>(nearest) % numSlots);
+			if (slot < 0)
+				slot += numSlots;
+			perSlot[static_cast<size_t>(slot)].push_back(static_cast<float>((position - nearest) / GrooveMap::slotsPerBeat));
+		}
+
+		// Slots nobody played stay on the grid
+		float offsets[GrooveMap::maxSlots] {};
+		for (int slot = 0; slot < numSlots; ++slot) {
+			auto& values = perSlot[static_cast<size_t>(slot)];
+			if (!values.empty())
+				offsets[slot] = median(values);
+		}
+
+		map.setOffsets(offsets, patternBeats);
+	}
+};
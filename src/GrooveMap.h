@@ -0,0 +1,141 @@
+// GrooveMap.h
+#pragma once
+#include <JuceHeader.h>
+#include <cmath>
+
+// Timing offsets of one groove pattern, as measured by GrooveAnalyzer.
+// The pattern spans numBeats beats with slotsPerBeat grid slots each and
+// repeats along the song; every slot holds its offset from the grid in beats.
+//
+// For playback the offsets are turned into a table of one cubic per slot,
+// normalized to the largest offset: the curve rests at the slot's offset on
+// the grid position and moves to the next one in between. Looking a beat up
+// is an index into the table. getRangeMs turns the normalized curve back into
+// the measured offsets at the host tempo.
+class GrooveMap {
+public:
+	static constexpr int slotsPerBeat = 4;
+	static constexpr int maxBeats = 16;
+	static constexpr int maxSlots = maxBeats * slotsPerBeat;
+
+	bool isEmpty() const { return numBeats == 0; }
+	int getNumBeats() const { return numBeats; }
+	int getNumSlots() const { return numBeats * slotsPerBeat; }
+	// Offset of a slot in beats, as measured
+	float getOffset(int slot) const { return offsets[slot]; }
+	// Largest absolute offset in beats; the normalized curve reaches +-1 there
+	float getPeak() const { return peak; }
+	// Range, in ms at bpm, for which range * 0.5 * curve is the measured offset
+	float getRangeMs(double bpm) const {
+		return bpm > 0.0 ? static_cast<float>(2.0 * peak * 60000.0 / bpm) : 0.0f;
+	}
+
+	void clear() {
+		numBeats = 0;
+		peak = 0.0f;
+	}
+
+	// offsets holds patternBeats * slotsPerBeat offsets in beats
+	void setOffsets(const float* newOffsets, int patternBeats) {
+		numBeats = jlimit(0, maxBeats, patternBeats);
+		peak = 0.0f;
+
+		for (int slot = 0; slot < getNumSlots(); ++slot) {
+			offsets[slot] = newOffsets[slot];
+			peak = jmax(peak, std::abs(offsets[slot]));
+		}
+
+		const float scale = peak > 0.0f ? 1.0f / peak : 0.0f;
+		for (int slot = 0; slot < getNumSlots(); ++slot) {
+			const float a = offsets[slot] * scale;
+			const float b = offsets[(slot + 1) % getNumSlots()] * scale;
+
+			// a + (b - a) * smoothstep(t)
+			auto& c = table[slot];
+			c[0] = a;
+			c[1] = 0.0f;
+			c[2] = 3.0f * (b - a);
+			c[3] = -2.0f * (b - a);
+		}
+	}
+
+	// Normalized curve at beat, in [-1, 1]
+	float getValue(double beat) const {
+		if (isEmpty())
+			return 0.0f;
+
+		int slot;
+		const float t = static_cast<float>(locate(beat, slot));
+		return evaluate(table[slot], t);
+	}
+
+	// Fills out[k * stride] for k in [0, numSamples) from startBeat, one table
+	// lookup per slot crossed
+	void fill(double startBeat, double beatIncrement, float* out, int numSamples, int stride = 1) const {
+		if (isEmpty()) {
+			for (int k = 0; k < numSamples; ++k)
+				out[k * stride] = 0.0f;
+			return;
+		}
+
+		const double slotIncrement = beatIncrement * slotsPerBeat;
+		int i = 0;
+
+		while (i < numSamples) {
+			int slot;
+			const double t0 = locate(startBeat + beatIncrement * i, slot);
+
+			int run = numSamples - i;
+			if (slotIncrement > 0.0)
+				run = static_cast<int>(jlimit(1.0, static_cast<double>(run), std::ceil((1.0 - t0) / slotIncrement)));
+
+			const auto& c = table[slot];
+			const float dt = static_cast<float>(slotIncrement);
+			for (int k = 0; k < run; ++k)
+				out[(i + k) * stride] = evaluate(c, static_cast<float>(t0) + dt * static_cast<float>(k));
+			i += run;
+		}
+	}
+
+	// Compact form for the plugin state: the beat count, then the offsets
+	void writeTo(MemoryBlock& dest) const {
+		MemoryOutputStream stream(dest, false);
+		stream.writeInt(numBeats);
+		for (int slot = 0; slot < getNumSlots(); ++slot)
+			stream.writeFloat(offsets[slot]);
+	}
+
+	bool readFrom(const void* data, size_t size) {
+		MemoryInputStream stream(data, size, false);
+		const int beats = stream.readInt();
+		if (beats < 0 || beats > maxBeats || stream.getNumBytesRemaining() < static_cast<int64>(beats * slotsPerBeat * sizeof(float)))
+			return false;
+
+		float newOffsets[maxSlots];
+		for (int slot = 0; slot < beats * slotsPerBeat; ++slot)
+			newOffsets[slot] = stream.readFloat();
+		setOffsets(newOffsets, beats);
+		return true;
+	}
+
+private:
+	int numBeats = 0;
+	float peak = 0.0f;
+	float offsets[maxSlots] {};
+	float table[maxSlots][4] {};
+
+	// Slot of beat within the pattern, and the position inside it
+	double locate(double beat, int& slot) const {
+		const double position = beat * slotsPerBeat;
+		const double whole = std::floor(position);
+		const int numSlots = getNumSlots();
+		slot = static_cast<int>(static_cast<int64>(whole) % numSlots);
+		if (slot < 0)
+			slot += numSlots;
+		return position - whole;
+	}
+
+	static float evaluate(const float* c, float t) {
+		return ((c[3] * t + c[2]) * t + c[1]) * t + c[0];
+	}
+};
@@ -0,0 +1,84 @@
+// History.h
+#pragma once
+#include <JuceHeader.h>
+#include <limits>
+#include <vector>
+
+// Min/max mipmap of the applied shift, independent of any pixel width.
+// Level 0 holds one entry per telemetry bucket, every level above merges two
+// entries of the one below. All levels retain the same span of time, so a
+// window of any length is answered from a level where each column reads
+// only a few entries.
+class History {
+public:
+	// Resolution of level 0; the telemetry bucket length is 1 / bucketsPerBeat
+	static constexpr int bucketsPerBeat = 256;
+	// Longest window that can be shown: 64 bars of 4 quarters
+	static constexpr int maxBeats = 64 * 4;
+	static constexpr int capacity = maxBeats * bucketsPerBeat;
+	static constexpr int numLevels = 17;
+	static_assert((1 << (numLevels - 1)) == capacity, "the top level holds one entry");
+
+	struct Span {
+		float min = std::numeric_limits<float>::max();
+		float max = std::numeric_limits<float>::lowest();
+
+		bool isEmpty() const { return min > max; }
+
+		void merge(const Span& other) {
+			min = jmin(min, other.min);
+			max = jmax(max, other.max);
+		}
+	};
+
+	History() {
+		for (int level = 0; level < numLevels; ++level)
+			levels[level].resize(static_cast<size_t>(capacity >> level));
+	}
+
+	void push(float min, float max) {
+		const Span span { min, max };
+
+		for (int level = 0; level < numLevels; ++level) {
+			auto& entry = levels[level][static_cast<size_t>((numPushed >> level) & ((capacity >> level) - 1))];
+
+			// The first base bucket of an entry starts it, the others merge into it
+			if ((numPushed & ((int64(1) << level) - 1)) == 0)
+				entry = span;
+			else
+				entry.merge(span);
+		}
+
+		++numPushed;
+	}
+
+	void clear() { numPushed = 0; }
+
+	// Number of base buckets pushed so far, also the index of the next one
+	int64 size() const { return numPushed; }
+
+	// Min/max over the base buckets [start, end). Empty if none of them is retained.
+	Span get(int64 start, int64 end) const {
+		Span result;
+		start = jmax(start, numPushed - capacity, int64(0));
+		end = jmin(end, numPushed);
+
+		// Largest aligned entry that fits, from the coarsest level down
+		while (start < end) {
+			int level = jmin(numLevels - 1, findHighestSetBit(static_cast<uint32>(end - start)));
+			while (level > 0 && ((start & ((int64(1) << level) - 1)) != 0 || start + (int64(1) << level) > end))
+				--level;
+
+			result.merge(levels[level][static_cast<size_t>((start >> level) & ((capacity >> level) - 1))]);
+			start += int64(1) << level;
+		}
+
+		return result;
+	}
+
+private:
+	std::vector<Span> levels[numLevels];
+	int64 numPushed = 0;
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(History)
+};
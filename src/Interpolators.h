@@ -0,0 +1,118 @@
+// Interpolators.h
+#pragma once
+#include <JuceHeader.h>
+#include <cmath>
+#include <cstdint>
+
+// Fractional-delay interpolators used by DelayKernel.
+// Each one reads numTaps consecutive ring samples, oldest first, of which
+// tapsAhead are newer than the integer read position. computeWeights turns a
+// row of fractions into one weight row per tap; rows are SIMD aligned and
+// padded to a multiple of the SIMD width, so the loops need no scalar tail.
+namespace Interpolators {
+	using SIMD = dsp::SIMDRegister<float>;
+	static constexpr int simdWidth = static_cast<int>(SIMD::SIMDNumElements);
+
+	enum class Type { linear = 0, lagrange, sinc };
+
+	struct Linear {
+		static constexpr int numTaps = 2;
+		static constexpr int tapsAhead = 0;
+
+		// taps: x[n - 1], x[n]
+		static void computeWeights(const float* fraction, float* const* weights, int paddedLength) {
+			const auto one = SIMD::expand(1.0f);
+			for (int i = 0; i < paddedLength; i += simdWidth) {
+				auto f = SIMD::fromRawArray(fraction + i);
+				f.copyToRawArray(weights[0] + i);
+				(one - f).copyToRawArray(weights[1] + i);
+			}
+		}
+	};
+
+	struct Lagrange3 {
+		static constexpr int numTaps = 4;
+		static constexpr int tapsAhead = 1;
+
+		// taps: x[n - 2], x[n - 1], x[n], x[n + 1], evaluated at n - fraction
+		static void computeWeights(const float* fraction, float* const* weights, int paddedLength) {
+			const auto zero = SIMD::expand(0.0f);
+			const auto one = SIMD::expand(1.0f);
+			const auto two = SIMD::expand(2.0f);
+			const auto half = SIMD::expand(0.5f);
+			const auto sixth = SIMD::expand(1.0f / 6.0f);
+
+			for (int i = 0; i < paddedLength; i += simdWidth) {
+				auto f = SIMD::fromRawArray(fraction + i);
+				auto fPlus1 = f + one;
+				auto fMinus1 = f - one;
+				auto fMinus2 = f - two;
+
+				(fPlus1 * f * fMinus1 * sixth).copyToRawArray(weights[0] + i);
+				(zero - fPlus1 * f * fMinus2 * half).copyToRawArray(weights[1] + i);
+				(fPlus1 * fMinus1 * fMinus2 * half).copyToRawArray(weights[2] + i);
+				(zero - f * fMinus1 * fMinus2 * sixth).copyToRawArray(weights[3] + i);
+			}
+		}
+	};
+
+	class WindowedSinc {
+	public:
+		static constexpr int numTaps = 8;
+		static constexpr int tapsAhead = 3;
+		static constexpr int numPhases = 1024;
+
+		// taps: x[n - 4] ... x[n + 3]
+		void computeWeights(const float* fraction, float* const* weights, int paddedLength) const {
+			for (int i = 0; i < paddedLength; ++i) {
+				const int phase = static_cast<int>(fraction[i] * numPhases + 0.5f);
+				const float* row = table + jlimit(0, numPhases, phase) * numTaps;
+
+				for (int k = 0; k < numTaps; ++k)
+					weights[k][i] = row[k];
+			}
+		}
+
+		// Built once per process and shared by every instance
+		static const WindowedSinc& get() {
+			static const WindowedSinc instance;
+			return instance;
+		}
+
+	private:
+		HeapBlock<float> storage;
+		float* table = nullptr;
+
+		WindowedSinc() {
+			// One 32 byte row per phase, starting on a cache line
+			constexpr uintptr_t cacheLine = 64;
+			storage.allocate(static_cast<size_t>((numPhases + 1) * numTaps) + cacheLine / sizeof(float), true);
+			table = reinterpret_cast<float*>((reinterpret_cast<uintptr_t>(storage.get()) + cacheLine - 1) & ~(cacheLine - 1));
+
+			constexpr double halfWidth = numTaps / 2;
+
+			for (int phase = 0; phase <= numPhases; ++phase) {
+				const double f = static_cast<double>(phase) / numPhases;
+				float* row = table + phase * numTaps;
+				double sum = 0.0;
+
+				for (int k = 0; k < numTaps; ++k) {
+					// Distance of the tap from the read position
+					const double x = k - halfWidth + f;
+					const double sinc = std::abs(x) < 1.0e-9 ? 1.0 : std::sin(MathConstants<double>::pi * x) / (MathConstants<double>::pi * x);
+					const double w = MathConstants<double>::pi * x / halfWidth;
+					const double blackman = std::abs(x) >= halfWidth ? 0.0 : 0.42 + 0.5 * std::cos(w) + 0.08 * std::cos(2.0 * w);
+
+					row[k] = static_cast<float>(sinc * blackman);
+					sum += row[k];
+				}
+
+				// Unity gain at DC for every phase
+				for (int k = 0; k < numTaps; ++k)
+					row[k] = static_cast<float>(row[k] / sum);
+			}
+		}
+
+		JUCE_DECLARE_NON_COPYABLE(WindowedSinc)
+	};
+}
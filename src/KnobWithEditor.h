@@ -4,7 +4,7 @@
 #include <memory.h>
 #include "PluginConfig.h"
 #include "Types.h"
-#include "LookAndFeel.h"
+#include "UiResources.h"
 
 class KnobWithEditor : public Component {
 	void commitEditorValue() {
@@ -14,7 +14,8 @@ class KnobWithEditor : public Component {
 		repaint();
 	}
 
-	std::unique_ptr<ModernLookAndFeel> lookAndFeel;
+	// Shared with every other knob, so are the look and feel's cached frames
+	SharedResourcePointer<UiResources> resources;
 	Slider slider;
 	TextEditor editor;
 	APVTS::SliderAttachment attachment;
@@ -29,8 +30,7 @@ public:
 		slider.setTooltip(parameter.desc);
 		editor.setTooltip(parameter.desc);
 
-		lookAndFeel = std::make_unique<ModernLookAndFeel>();
-		slider.setLookAndFeel(lookAndFeel.get());
+		slider.setLookAndFeel(&resources->lookAndFeel);
 		slider.setSliderStyle(Slider::RotaryVerticalDrag);
 		slider.setTextBoxStyle(Slider::NoTextBox, false, 0, 0);
 
@@ -52,8 +52,8 @@ public:
 		slider.onValueChange = [this] {
 			editor.setText(String(slider.getValue(), 1), dontSendNotification);
 
+			// The slider repaints itself, and with it what is painted over it
 			updateEditorBounds();
-			repaint();
 		};
 
 		slider.onDragStart = [this] {
@@ -69,6 +69,10 @@ public:
 		addAndMakeVisible(editor);
 	}
 
+	~KnobWithEditor() override {
+		slider.setLookAndFeel(nullptr);
+	}
+
 	bool shouldShowValue() const {
 		return slider.isMouseOver() || editor.isMouseOver() || dragging;
 	}
@@ -92,7 +96,7 @@ public:
 
 			float fontSize = jmin(bounds.getHeight(), bounds.getWidth()) * 0.17f;
 			g.setColour(Colours::white.withAlpha(0.9f));
-			g.setFont(FontOptions(fontSize).withStyle("Regular"));
+			g.setFont(resources->labelFont.withHeight(fontSize));
 			g.drawText(displayName, bounds, Justification::centred);
 		}
 	}
@@ -1,23 +1,36 @@
 // LookAndFeel.h
 #pragma once
 #include <JuceHeader.h>
+#include <map>
+#include <tuple>
 
 namespace ModernTheme {
 	static const Colour& mainAccent = Colours::purple.darker(0.3);
 	static const Colour& background = Colours::darkgrey.darker(2);
 }
 
+// One instance is shared by every knob of every open editor, see UiResources.
+// Knob frames are rendered once per size, scale and quantized position and then
+// only blitted, so moving a knob doesn't rebuild its gradients and paths.
 class ModernLookAndFeel : public LookAndFeel_V4 {
-public:
-	ModernLookAndFeel() {
-		setColour(ResizableWindow::backgroundColourId, ModernTheme::background);
-		setColour(Label::textColourId, Colours::white);
-	}
-
-	void drawRotarySlider(
-			Graphics& g, int x, int y, int width, int height,
-			float sliderPosProportional, float rotaryStartAngle,
-			float rotaryEndAngle, Slider& slider) override {
+	struct FrameKey {
+		int width, height, scale, step, startAngle, endAngle;
+
+		bool operator<(const FrameKey& other) const {
+			return std::tie(width, height, scale, step, startAngle, endAngle)
+				 < std::tie(other.width, other.height, other.scale, other.step, other.startAngle, other.endAngle);
+		}
+	};
+
+	// Positions a knob can show; finer than a pixel along the arc at the usual sizes
+	static constexpr int numSteps = 256;
+	// Dropped all at once when full, which only happens after many resizes
+	static constexpr size_t maxFrames = 2048;
+	std::map<FrameKey, Image> frames;
+
+	static void drawKnob(
+			Graphics& g, float x, float y, float width, float height,
+			float sliderPosProportional, float rotaryStartAngle, float rotaryEndAngle) {
 		auto radius = jmin(width / 2, height / 2) - 4.0f;
 		auto centreX = x + width / 2.0f;
 		auto centreY = y + height / 2.0f;
@@ -77,6 +90,44 @@ public:
 		g.strokePath(valueArc, PathStrokeType(strokeThickness, PathStrokeType::curved, PathStrokeType::rounded));
 	}
 
+public:
+	ModernLookAndFeel() {
+		setColour(ResizableWindow::backgroundColourId, ModernTheme::background);
+		setColour(Label::textColourId, Colours::white);
+	}
+
+	void drawRotarySlider(
+			Graphics& g, int x, int y, int width, int height,
+			float sliderPosProportional, float rotaryStartAngle,
+			float rotaryEndAngle, Slider& slider) override {
+		ignoreUnused(slider);
+		if (width <= 0 || height <= 0)
+			return;
+
+		const float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+		const int step = roundToInt(jlimit(0.0f, 1.0f, sliderPosProportional) * (numSteps - 1));
+		const FrameKey key {
+			width, height, roundToInt(scale * 100.0f), step,
+			roundToInt(rotaryStartAngle * 1000.0f), roundToInt(rotaryEndAngle * 1000.0f)
+		};
+
+		auto frame = frames.find(key);
+		if (frame == frames.end()) {
+			if (frames.size() >= maxFrames)
+				frames.clear();
+
+			Image image(Image::ARGB, jmax(1, roundToInt(width * scale)), jmax(1, roundToInt(height * scale)), true);
+			Graphics imageGraphics(image);
+			imageGraphics.addTransform(AffineTransform::scale(scale));
+			drawKnob(imageGraphics, 0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height),
+					 static_cast<float>(step) / (numSteps - 1), rotaryStartAngle, rotaryEndAngle);
+
+			frame = frames.emplace(key, image).first;
+		}
+
+		g.drawImage(frame->second, Rectangle<int>(x, y, width, height).toFloat());
+	}
+
 	Label * createSliderTextBox(Slider& slider) override {
 		auto* label = LookAndFeel_V4::createSliderTextBox(slider);
 
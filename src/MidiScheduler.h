@@ -0,0 +1,98 @@
+// MidiScheduler.h
+#pragma once
+#include <JuceHeader.h>
+#include <limits>
+
+// Holds MIDI events that were moved past the end of their block.
+// Times are absolute sample positions on the processor's own clock, so they
+// survive transport jumps. All storage is allocated in the first prepare.
+class MidiScheduler {
+public:
+	static constexpr int capacity = 4096;
+
+	// The owner restarts its clock at 0 afterwards
+	void prepare() {
+		if (pending == nullptr) {
+			pending.allocate(static_cast<size_t>(capacity), true);
+			numPending = 0;
+		}
+		reset();
+	}
+
+	// Drops the queue except its note-offs, which go out at the start of the
+	// next block, so a prepare during playback leaves no note hanging
+	void reset() {
+		int kept = 0;
+		for (int i = 0; i < numPending; ++i) {
+			auto event = pending[i];
+			if (isNoteOff(event)) {
+				event.time = 0;
+				pending[kept++] = event;
+			}
+		}
+		numPending = kept;
+
+		for (auto& time : lastKeyTime)
+			time = std::numeric_limits<int64>::min();
+	}
+
+	int getNumPending() const { return numPending; }
+
+	// Note on/off events of one key keep their order: an event is never
+	// scheduled before the previous event of the same channel and note.
+	int64 orderForKey(const uint8* data, int64 time) {
+		const int key = (data[0] & 0x0f) * 128 + (data[1] & 0x7f);
+		time = jmax(time, lastKeyTime[key]);
+		lastKeyTime[key] = time;
+		return time;
+	}
+
+	// Returns false if the queue is full, the caller then passes the event on unmoved.
+	// Only short messages fit, SysEx has to be passed on by the caller.
+	bool schedule(const uint8* data, int numBytes, int64 time) {
+		if (numPending == capacity || numBytes > 3)
+			return false;
+
+		auto& event = pending[numPending++];
+		event.time = time;
+		event.size = static_cast<uint8>(numBytes);
+		for (int i = 0; i < numBytes; ++i)
+			event.data[i] = data[i];
+		return true;
+	}
+
+	// Adds every event due before blockStart + numSamples to dest and removes it from the queue
+	void emit(MidiBuffer& dest, int64 blockStart, int numSamples) {
+		const int64 blockEnd = blockStart + numSamples;
+		int kept = 0;
+
+		for (int i = 0; i < numPending; ++i) {
+			const auto& event = pending[i];
+			if (event.time < blockEnd) {
+				const int position = static_cast<int>(jmax<int64>(0, event.time - blockStart));
+				dest.addEvent(event.data, event.size, position);
+			}
+			else {
+				pending[kept++] = event;
+			}
+		}
+
+		numPending = kept;
+	}
+
+private:
+	struct Event {
+		int64 time;
+		uint8 data[3];
+		uint8 size;
+	};
+
+	static bool isNoteOff(const Event& event) {
+		const int status = event.data[0] & 0xf0;
+		return event.size == 3 && (status == 0x80 || (status == 0x90 && event.data[2] == 0));
+	}
+
+	HeapBlock<Event> pending;
+	int numPending = 0;
+	int64 lastKeyTime[16 * 128] {};
+};
@@ -0,0 +1,209 @@
+// ModulationSources.h
+#pragma once
+#include <JuceHeader.h>
+#include <cmath>
+#include <limits>
+
+inline unsigned int hashBits(unsigned int x) {
+	x = ((x >> 16) ^ x) * 0x45d9f3b;
+	x = ((x >> 16) ^ x) * 0x45d9f3b;
+	x = (x >> 16) ^ x;
+	return x;
+}
+
+inline float bitsToFloat(unsigned int x) {
+	return (static_cast<float>(x) / static_cast<float>(std::numeric_limits<unsigned int>::max()) * 2.0f) - 1.0f;
+}
+
+inline float hashToFloat(int seed, int index, int subSeed) {
+	return bitsToFloat(hashBits(static_cast<unsigned int>(seed + index + subSeed)));
+}
+
+// Shapes the curve can take. The curve is split into segments of Speed
+// beats, and every source describes one segment of one lane by a few
+// coefficients, computed once per segment from hashed anchors:
+//
+//   static void coefficients(int seed, int segmentIndex, int lane, float* c, int stride);
+//   template <int Stride> static float evaluate(const float* c, float t);
+//
+// c[k * stride] is coefficient k, t runs over [0, 1) and evaluate returns a
+// value in [-1, 1]. evaluate is inlined into the block loops, so each source
+// gets its own loop without a call per sample.
+namespace ModulationSources {
+	// groove isn't a segment source, CurveGenerator plays the GrooveMap for it
+	enum class Type { bezier = 0, smooth, drift, stepped, swing, groove };
+
+	static constexpr int numCoefficients = 8;
+
+	// Anchor of one lane. Lane 0 is hashToFloat, every other lane offsets the
+	// seed so each channel gets its own curve.
+	inline float anchor(int seed, int index, int subSeed, int lane) {
+		return bitsToFloat(hashBits(static_cast<unsigned int>(seed + index + subSeed) + static_cast<unsigned int>(lane) * 0x9e3779b9u));
+	}
+
+	// Cubic in power basis, c[0] + c[1] t + c[2] t^2 + c[3] t^3
+	template <int Stride>
+	inline float cubic(const float* c, float t) {
+		return ((c[3 * Stride] * t + c[2 * Stride]) * t + c[Stride]) * t + c[0];
+	}
+
+	// Integer division rounding towards negative infinity, for a positive divisor.
+	// Segments before beat 0 have negative indices.
+	inline int floorDivide(int value, int divisor) {
+		const int quotient = value / divisor;
+		return value % divisor < 0 ? quotient - 1 : quotient;
+	}
+
+	// a + (b - a) * smoothstep(t), flat at both anchors
+	inline void smoothstep(float a, float b, float* c, int stride) {
+		c[0] = a;
+		c[stride] = 0.0f;
+		c[2 * stride] = 3.0f * (b - a);
+		c[3 * stride] = -2.0f * (b - a);
+	}
+
+	// The original shape: a weighted cubic between two anchors, with a random
+	// tension at each anchor. Stored as numerator and denominator cubics.
+	struct Bezier {
+		static constexpr Type type = Type::bezier;
+
+		static void coefficients(int seed, int segmentIndex, int lane, float* c, int stride) {
+			const float y0 = anchor(seed, segmentIndex, 0, lane);
+			const float y3 = anchor(seed, segmentIndex + 1, 0, lane);
+
+			// Tensions map the raw hash [0, 1] to [0.1, 0.45]
+			constexpr float minTension = 0.1f;
+			constexpr float maxTension = 0.45f;
+			const float tensionOut = jmap(std::abs(anchor(seed, segmentIndex, 100, lane)), 0.0f, 1.0f, minTension, maxTension);
+			const float tensionIn = jmap(std::abs(anchor(seed, segmentIndex + 1, 100, lane)), 0.0f, 1.0f, minTension, maxTension);
+
+			const float w1 = 3.0f * (1.0f + tensionOut * 5.0f);
+			const float w2 = 3.0f * (1.0f + tensionIn * 5.0f);
+
+			// term0 + term1 = (1-t)^3 + w1 (1-t)^2 t  -> weight of y0
+			// term2 + term3 = w2 t^2 (1-t) + t^3      -> weight of y3
+			const float a[4] { 1.0f, w1 - 3.0f, 3.0f - 2.0f * w1, w1 - 1.0f };
+			const float b[4] { 0.0f, 0.0f, w2, 1.0f - w2 };
+
+			for (int i = 0; i < 4; ++i) {
+				c[i * stride] = a[i] * y0 + b[i] * y3;
+				c[(i + 4) * stride] = a[i] + b[i];
+			}
+		}
+
+		template <int Stride>
+		static float evaluate(const float* c, float t) {
+			return cubic<Stride>(c, t) / cubic<Stride>(c + 4 * Stride, t);
+		}
+	};
+
+	// Value noise through a Catmull-Rom spline: smooth, without stopping at the anchors
+	struct Smooth {
+		static constexpr Type type = Type::smooth;
+		// Catmull-Rom overshoots by up to 25 %, this keeps it inside [-1, 1]
+		static constexpr float scale = 0.8f;
+
+		static void coefficients(int seed, int segmentIndex, int lane, float* c, int stride) {
+			const float p0 = scale * anchor(seed, segmentIndex - 1, 0, lane);
+			const float p1 = scale * anchor(seed, segmentIndex, 0, lane);
+			const float p2 = scale * anchor(seed, segmentIndex + 1, 0, lane);
+			const float p3 = scale * anchor(seed, segmentIndex + 2, 0, lane);
+
+			c[0] = p1;
+			c[stride] = 0.5f * (p2 - p0);
+			c[2 * stride] = p0 - 2.5f * p1 + 2.0f * p2 - 0.5f * p3;
+			c[3 * stride] = 0.5f * (p3 - p0) + 1.5f * (p1 - p2);
+		}
+
+		template <int Stride>
+		static float evaluate(const float* c, float t) { return cubic<Stride>(c, t); }
+	};
+
+	// 1/f drift: equal-weight octaves of smoothstep value noise, each twice as
+	// slow as the one before (Voss-McCartney). Every octave is a cubic over
+	// the segment too, so they sum into one.
+	struct Drift {
+		static constexpr Type type = Type::drift;
+		static constexpr int numOctaves = 4;
+
+		static void coefficients(int seed, int segmentIndex, int lane, float* c, int stride) {
+			float sum[4] {};
+			constexpr float weight = 1.0f / numOctaves;
+
+			for (int octave = 0; octave < numOctaves; ++octave) {
+				// This segment covers [p, p + q) of the octave's own segment
+				const int length = 1 << octave;
+				const int coarse = floorDivide(segmentIndex, length);
+				const float q = 1.0f / static_cast<float>(length);
+				const float p = static_cast<float>(segmentIndex - coarse * length) * q;
+
+				const int subSeed = 7919 * (octave + 1);
+				const float a = anchor(seed, coarse, subSeed, lane);
+				const float d = anchor(seed, coarse + 1, subSeed, lane) - a;
+
+				// smoothstep(p + q t) = 3 (p + q t)^2 - 2 (p + q t)^3, expanded in t
+				sum[0] += weight * (a + d * (3.0f * p * p - 2.0f * p * p * p));
+				sum[1] += weight * d * (6.0f * p * q - 6.0f * p * p * q);
+				sum[2] += weight * d * (3.0f * q * q - 6.0f * p * q * q);
+				sum[3] += weight * d * (-2.0f * q * q * q);
+			}
+
+			for (int i = 0; i < 4; ++i)
+				c[i * stride] = sum[i];
+		}
+
+		template <int Stride>
+		static float evaluate(const float* c, float t) { return cubic<Stride>(c, t); }
+	};
+
+	// Holds a random value per segment, with a short glide so the delay doesn't jump
+	struct Stepped {
+		static constexpr Type type = Type::stepped;
+		// Part of the segment spent gliding from the previous value
+		static constexpr float glide = 1.0f / 16.0f;
+
+		static void coefficients(int seed, int segmentIndex, int lane, float* c, int stride) {
+			c[0] = anchor(seed, segmentIndex - 1, 0, lane);
+			c[stride] = anchor(seed, segmentIndex, 0, lane);
+		}
+
+		template <int Stride>
+		static float evaluate(const float* c, float t) {
+			const float x = jmin(1.0f, t * (1.0f / glide));
+			return c[0] + (c[Stride] - c[0]) * x * x * (3.0f - 2.0f * x);
+		}
+	};
+
+	// Locked to the segment grid: even segments start early and odd ones late,
+	// with some jitter, and the curve rests at every anchor. At a Speed of one
+	// beat, 2 and 4 lag behind 1 and 3 like a laid-back backbeat; Range sets
+	// how far.
+	struct Swing {
+		static constexpr Type type = Type::swing;
+		static constexpr float depth = 0.75f;
+		static constexpr float jitter = 0.25f;
+
+		static float value(int seed, int index, int lane) {
+			return ((index & 1) != 0 ? depth : -depth) + jitter * anchor(seed, index, 0, lane);
+		}
+
+		static void coefficients(int seed, int segmentIndex, int lane, float* c, int stride) {
+			smoothstep(value(seed, segmentIndex, lane), value(seed, segmentIndex + 1, lane), c, stride);
+		}
+
+		template <int Stride>
+		static float evaluate(const float* c, float t) { return cubic<Stride>(c, t); }
+	};
+
+	// Calls fn with the source selected by type
+	template <typename Fn>
+	static void withSource(Type type, Fn&& fn) {
+		switch (type) {
+			case Type::smooth:  fn(Smooth {}); break;
+			case Type::drift:   fn(Drift {}); break;
+			case Type::stepped: fn(Stepped {}); break;
+			case Type::swing:   fn(Swing {}); break;
+			default:            fn(Bezier {}); break;
+		}
+	}
+}
@@ -0,0 +1,153 @@
+// OversampledDelay.h
+#pragma once
+#include <JuceHeader.h>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include "DelayKernel.h"
+
+// Offline quality tier: the modulated delay runs at factor times the rate,
+// with the windowed sinc, between the up and down filters of dsp::Oversampling.
+// The delays come in at the base rate and are interpolated linearly.
+//
+// The filters are linear-phase FIR half-bands. Their latency is compensated
+// here: while this tier runs, the plugin reports getLatencyPadding() whole
+// samples on top and the kernel delays by what the filters don't cover, so
+// after the host's compensation the output lines up in time with the
+// real-time tier. It is band-limited by the filters, not bit-identical.
+class OversampledDelay {
+public:
+	static constexpr int order = 2;
+	static constexpr int factor = 1 << order;
+	static constexpr auto filterType = dsp::Oversampling<float>::filterHalfBandFIREquiripple;
+
+	// Whole base-rate samples that cover the filter latency and the sinc's lookahead
+	static int getLatencyPadding() {
+		static const int padding = [] {
+			dsp::Oversampling<float> probe(1, order, filterType, true);
+			return static_cast<int>(std::ceil(probe.getLatencyInSamples()
+				+ static_cast<double>(Interpolators::WindowedSinc::tapsAhead) / factor));
+		}();
+		return padding;
+	}
+
+	// Sizes are at the base rate; maxDelaySamples excludes the padding.
+	// Returns false, and stays released, if the kernel's memory couldn't be allocated.
+	bool prepare(int channels, int maxDelaySamples, int blockSize) {
+		numChannels = jmax(1, channels);
+		maxBlockSize = jmax(1, blockSize);
+
+		oversampling = std::make_unique<dsp::Oversampling<float>>(static_cast<size_t>(numChannels), order, filterType, true);
+		oversampling->initProcessing(static_cast<size_t>(maxBlockSize));
+
+		// base delay + padding = filter latency + (oversampled delay + offset) / factor,
+		// and the offset is at least the sinc's lookahead
+		paddingOffset = (static_cast<float>(getLatencyPadding()) - oversampling->getLatencyInSamples()) * factor;
+		if (!kernel.prepare(numChannels, (maxDelaySamples + DelayKernel::maxLookahead) * factor + static_cast<int>(std::ceil(paddingOffset)), maxBlockSize * factor)) {
+			release();
+			return false;
+		}
+		kernel.setDelayOffset(paddingOffset);
+
+		const size_t length = static_cast<size_t>(maxBlockSize * factor);
+		delayBlock.assign(length * static_cast<size_t>(numChannels), 0.0f);
+		delays.resize(static_cast<size_t>(numChannels));
+		for (int ch = 0; ch < numChannels; ++ch)
+			delays[static_cast<size_t>(ch)] = delayBlock.data() + length * static_cast<size_t>(ch);
+		upChannels.resize(static_cast<size_t>(numChannels));
+		lastDelays.assign(static_cast<size_t>(numChannels), 0.0f);
+		hasLastDelays = false;
+		return true;
+	}
+
+	void release() {
+		oversampling.reset();
+		std::vector<float>().swap(delayBlock);
+	}
+
+	bool isPrepared() const { return oversampling != nullptr; }
+
+	// Base-rate samples added to every delay, like DelayKernel::setDelayOffset.
+	// At most DelayKernel::maxLookahead.
+	void setDelayOffset(float samples) {
+		kernel.setDelayOffset(paddingOffset + jlimit(0.0f, static_cast<float>(DelayKernel::maxLookahead), samples) * factor);
+	}
+
+	void reset() {
+		if (oversampling != nullptr)
+			oversampling->reset();
+		kernel.reset();
+		hasLastDelays = false;
+	}
+
+	// Same arguments as DelayKernel::process, at the base rate
+	void process(AudioBuffer<float>& buffer, int startSample, int numSamples, const float* baseDelays) {
+		const int channels = jmin(buffer.getNumChannels(), numChannels);
+		upsampleDelays(baseDelays, delays[0], numSamples, 0);
+		// Every channel continues from the shared delay if the next block is per channel
+		std::fill(lastDelays.begin() + 1, lastDelays.end(), lastDelays[0]);
+		hasLastDelays = true;
+
+		processOversampled(buffer, startSample, numSamples, channels, [&] (AudioBuffer<float>& up) {
+			kernel.process(up, 0, up.getNumSamples(), delays[0], Interpolators::Type::sinc);
+		});
+	}
+
+	// Same arguments as DelayKernel::processPerChannel, at the base rate
+	void processPerChannel(AudioBuffer<float>& buffer, int startSample, int numSamples, const float* const* baseDelays) {
+		const int channels = jmin(buffer.getNumChannels(), numChannels);
+		for (int ch = 0; ch < channels; ++ch)
+			upsampleDelays(baseDelays[ch], delays[static_cast<size_t>(ch)], numSamples, ch);
+		hasLastDelays = true;
+
+		processOversampled(buffer, startSample, numSamples, channels, [&] (AudioBuffer<float>& up) {
+			kernel.processPerChannel(up, 0, up.getNumSamples(), delays.data(), Interpolators::Type::sinc);
+		});
+	}
+
+private:
+	std::unique_ptr<dsp::Oversampling<float>> oversampling;
+	DelayKernel kernel;
+	int numChannels = 0;
+	int maxBlockSize = 0;
+	// Oversampled samples that make the filter latency up to the reported padding
+	float paddingOffset = 0.0f;
+	// Oversampled delays per channel, and the last base-rate delay of each channel
+	std::vector<float> delayBlock;
+	std::vector<float*> delays;
+	std::vector<float*> upChannels;
+	std::vector<float> lastDelays;
+	bool hasLastDelays = false;
+
+	// Ramps from the previous base delay to this one over factor samples, scaled to the oversampled rate
+	void upsampleDelays(const float* in, float* out, int numSamples, int channel) {
+		float last = hasLastDelays ? lastDelays[static_cast<size_t>(channel)] : in[0];
+
+		for (int i = 0; i < numSamples; ++i) {
+			const float step = (in[i] - last) / factor;
+			for (int k = 0; k < factor; ++k)
+				out[i * factor + k] = (last + step * static_cast<float>(k + 1)) * factor;
+			last = in[i];
+		}
+
+		lastDelays[static_cast<size_t>(channel)] = last;
+	}
+
+	template <typename Fn>
+	void processOversampled(AudioBuffer<float>& buffer, int startSample, int numSamples, int channels, Fn&& fn) {
+		jassert(numSamples <= maxBlockSize);
+		auto block = dsp::AudioBlock<float>(buffer).getSubsetChannelBlock(0, static_cast<size_t>(channels))
+			.getSubBlock(static_cast<size_t>(startSample), static_cast<size_t>(numSamples));
+
+		auto upBlock = oversampling->processSamplesUp(block);
+		for (int ch = 0; ch < channels; ++ch)
+			upChannels[static_cast<size_t>(ch)] = upBlock.getChannelPointer(static_cast<size_t>(ch));
+
+		// Refers to the oversampler's memory, nothing is allocated for up to 32 channels
+		AudioBuffer<float> up(upChannels.data(), channels, static_cast<int>(upBlock.getNumSamples()));
+		fn(up);
+
+		oversampling->processSamplesDown(block);
+	}
+};
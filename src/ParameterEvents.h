@@ -0,0 +1,61 @@
+// ParameterEvents.h
+#pragma once
+#include <JuceHeader.h>
+
+// Parameter changes inside the next block, at their sample offsets.
+// Filled and consumed on the thread that calls processBlock, so nothing is
+// shared; storage is allocated in prepare.
+class ParameterEvents {
+public:
+	struct Event {
+		int sampleOffset;
+		// Index into the parameter Registry
+		int parameter;
+		float value;
+	};
+
+	void prepare(int maxEvents) {
+		if (maxEvents > capacity) {
+			events.allocate(static_cast<size_t>(maxEvents), false);
+			capacity = maxEvents;
+		}
+		clear();
+	}
+
+	void clear() { numEvents = 0; }
+
+	// Keeps the events ordered by offset, and in call order at the same offset.
+	// Returns false when full; the event is then dropped.
+	bool add(const Event& event) {
+		if (numEvents == capacity)
+			return false;
+
+		int i = numEvents++;
+		for (; i > 0 && events[i - 1].sampleOffset > event.sampleOffset; --i)
+			events[i] = events[i - 1];
+		events[i] = event;
+		return true;
+	}
+
+	int size() const { return numEvents; }
+	const Event& operator[](int index) const { return events[index]; }
+
+	// Events at or past the end of the block land on its last sample
+	void clampOffsets(int maxOffset) {
+		for (int i = 0; i < numEvents; ++i)
+			events[i].sampleOffset = jmin(events[i].sampleOffset, maxOffset);
+	}
+
+	// Bit i is set if parameter i has an event this block
+	uint32 getParameterMask() const {
+		uint32 mask = 0;
+		for (int i = 0; i < numEvents; ++i)
+			mask |= uint32(1) << events[i].parameter;
+		return mask;
+	}
+
+private:
+	HeapBlock<Event> events;
+	int capacity = 0;
+	int numEvents = 0;
+};
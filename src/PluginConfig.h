@@ -1,9 +1,10 @@
 #pragma once
 
 #include <JuceHeader.h>
-#include <functional>
 #include <atomic>
+#include <tuple>
 #include "Types.h"
+#include "BlockSmoothedValue.h"
 
 struct ParameterSettings {
 	const String& name;
@@ -13,38 +14,97 @@ struct ParameterSettings {
 	const String& desc;
 };
 
+// Compile-time list of the smoothed float parameters, in display order.
+// Parameters, Knobs and the parameter layout are all generated from it.
+template <const ParameterSettings&... Settings>
+struct ParameterRegistry {
+	static constexpr size_t size = sizeof...(Settings);
+
+	template <template <const ParameterSettings&> class Item>
+	using Tuple = std::tuple<Item<Settings>...>;
+
+	// Constructs every Item<Settings> from the same argument, in place
+	template <template <const ParameterSettings&> class Item, typename Arg>
+	static Tuple<Item> make(Arg& arg) {
+		return Tuple<Item>(((void) Settings, arg)...);
+	}
+};
+
 namespace PluginConfig {
-	static const ParameterSettings range {
+	// inline, so every translation unit sees the same object when used as a template argument
+	inline const ParameterSettings range {
 		"Range",
 		0.0f,
 		200.0f,
 		0.0f,
 		"Sets the amount of ms the delay can go up + down (in total). Do not automate this parameter."
 	};
-	static const ParameterSettings center {
+	inline const ParameterSettings center {
 		"Center",
 		-1.0f,
 		1.0f,
 		0.0f,
 		"Sets the center of the LFO. Do not automate this parameter."
 	};
-	static const ParameterSettings speed {
+	inline const ParameterSettings speed {
 		"Speed",
 		1.0f,
 		16.0f,
 		1.0f,
 		"Sets the time for one slope to finish in beats. Feel free to automate this parameter."
 	};
+	inline const ParameterSettings spread {
+		"Spread",
+		0.0f,
+		1.0f,
+		0.0f,
+		"Blends from all channels following one curve (0) to every channel following its own curve (1)."
+	};
+	static const ParameterSettings interpolation {
+		"Interpolation",
+		0.0f,
+		2.0f,
+		0.0f,
+		"Sets how the delay line reads between samples. Lagrange and Sinc keep the highs when the delay moves, at a higher CPU cost and 1 or 3 samples of extra latency."
+	};
+	static const StringArray interpolationTypes { "Linear", "Lagrange", "Sinc" };
+	static const ParameterSettings shape {
+		"Shape",
+		0.0f,
+		5.0f,
+		0.0f,
+		"Sets the character of the curve: Bezier curves, smooth noise, slow 1/f drift, held random steps, a swing locked to the Speed grid, or the groove taken from a reference recording. Groove plays the recording's timing at Range 0; a higher Range scales it to that size."
+	};
+	static const StringArray shapeTypes { "Bezier", "Smooth", "Drift", "Stepped", "Swing", "Groove" };
+	static const ParameterSettings maxRange {
+		"Max Range",
+		0.0f,
+		5.0f,
+		5.0f,
+		"Sets the largest Range and with it the latency budget. Range is clamped to it, and only the latency it needs is reported."
+	};
+	static const StringArray maxRangeChoices { "5 ms", "10 ms", "20 ms", "50 ms", "100 ms", "200 ms" };
+	static const float maxRangeMs[] { 5.0f, 10.0f, 20.0f, 50.0f, 100.0f, 200.0f };
+	static const ParameterSettings lateOnly {
+		"Late Only",
+		0.0f,
+		1.0f,
+		0.0f,
+		"Only ever delays, so no latency is reported. Center is ignored and the curve swings between 0 ms and Range, plus the few samples Lagrange and Sinc read ahead."
+	};
 	static const float ramptime = 0.05;
+
+	// Adding a smoothed parameter only takes its settings above and an entry here
+	using Registry = ParameterRegistry<range, center, speed, spread>;
 }
 
+template <const ParameterSettings& Settings>
 struct Parameter {
-	ParameterSettings settings;
+	const ParameterSettings& settings = Settings;
 	std::atomic<float>* parameter = nullptr;
-	SmoothedValue<float> smoothed;
-
-	Parameter(ParameterSettings parameterSettings)
-	: settings(parameterSettings) {}
+	BlockSmoothedValue smoothed;
+	// This block's smoothed values, filled by fillBlock
+	HeapBlock<float> values;
 
 	void link(APVTS& apvts, double sampleRate) {
 		parameter = apvts.getRawParameterValue(settings.name);
@@ -53,20 +113,61 @@ struct Parameter {
 			smoothed.setCurrentAndTargetValue(parameter->load());
 		}
 	}
+
+	void prepare(double sampleRate, int maxBlockSize) {
+		smoothed.reset(sampleRate, PluginConfig::ramptime);
+		// Start from the current value instead of ramping from a stale one
+		if (parameter)
+			smoothed.setCurrentAndTargetValue(parameter->load());
+		smoothed.prepare(maxBlockSize);
+		values.allocate(static_cast<size_t>(jmax(1, maxBlockSize)), true);
+	}
+
+	const float* fillBlock(int numSamples) {
+		smoothed.fill(values.get(), numSamples);
+		return values.get();
+	}
 };
 
 struct Parameters {
-	// Initialize with hardcoded values immediately
-	Parameter range { PluginConfig::range };
-	Parameter center { PluginConfig::center };
-	Parameter speed { PluginConfig::speed };
-
-	// Default constructor is fine now
-	Parameters() {}
-
-	void forEach(std::function<void(Parameter&)> callback) {
-		callback(range);
-		callback(center);
-		callback(speed);
+	PluginConfig::Registry::Tuple<Parameter> items;
+
+	template <const ParameterSettings& Settings>
+	Parameter<Settings>& get() { return std::get<Parameter<Settings>>(items); }
+
+	template <const ParameterSettings& Settings>
+	const Parameter<Settings>& get() const { return std::get<Parameter<Settings>>(items); }
+
+	// Statically dispatched: callback is usually a generic lambda
+	template <typename Callback>
+	void forEach(Callback&& callback) {
+		std::apply([&callback] (auto&... parameter) { (callback(parameter), ...); }, items);
+	}
+
+	// Calls callback(parameter, index) with the parameter's position in the Registry
+	template <typename Callback>
+	void forEachIndexed(Callback&& callback) {
+		int index = 0;
+		forEach([&callback, &index] (auto& parameter) { callback(parameter, index++); });
+	}
+
+	// Position of the parameter with these settings in the Registry, or -1
+	int indexOf(const ParameterSettings& settings) {
+		int found = -1;
+		forEachIndexed([&settings, &found] (auto& parameter, int index) {
+			if (&parameter.settings == &settings)
+				found = index;
+		});
+		return found;
+	}
+
+	// Position of the parameter with this ID in the Registry, or -1
+	int indexOf(const String& name) {
+		int found = -1;
+		forEachIndexed([&name, &found] (auto& parameter, int index) {
+			if (parameter.settings.name == name)
+				found = index;
+		});
+		return found;
 	}
 };
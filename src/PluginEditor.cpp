@@ -2,7 +2,6 @@
 #include <vector>
 #include "PluginEditor.h"
 #include "PluginConfig.h"
-#include "Defer.h"
 
 //==============================================================================
 Editor::Editor(Humanizer& p)
@@ -10,32 +9,149 @@ Editor::Editor(Humanizer& p)
 		, processorRef(p)
 		, knobs(p.apvts)
 		, diagram() {
-	openGLContext.attachTo(* this);
+	setOpaque(true);
 	setSize(600, 400);
 	setResizable(true, true);
 	setResizeLimits(300, 250, 1200, 800);
 
-	setLookAndFeel(&modernLook);
-	tooltipWindow->setMillisecondsBeforeTipAppears(1500);
+	setLookAndFeel(&resources->lookAndFeel);
 
 	processorRef.apvts.addParameterListener(PluginConfig::range.name, this);
 	processorRef.apvts.addParameterListener(PluginConfig::center.name, this);
+	processorRef.apvts.addParameterListener(PluginConfig::maxRange.name, this);
+	processorRef.apvts.addParameterListener(PluginConfig::lateOnly.name, this);
+	processorRef.apvts.addParameterListener(PluginConfig::shape.name, this);
 
 	updateDiagramLimits();
 
+	interpolationBox.addItemList(PluginConfig::interpolationTypes, 1);
+	interpolationBox.setTooltip(PluginConfig::interpolation.desc);
+	interpolationAttachment = std::make_unique<APVTS::ComboBoxAttachment>(
+		processorRef.apvts, PluginConfig::interpolation.name, interpolationBox);
+	// Notes are moved whole, nothing is interpolated
+	interpolationBox.setEnabled(!processorRef.isMidiEffect());
+
+	shapeBox.addItemList(PluginConfig::shapeTypes, 1);
+	shapeBox.setTooltip(PluginConfig::shape.desc);
+	shapeAttachment = std::make_unique<APVTS::ComboBoxAttachment>(
+		processorRef.apvts, PluginConfig::shape.name, shapeBox);
+
+	maxRangeBox.addItemList(PluginConfig::maxRangeChoices, 1);
+	maxRangeBox.setTooltip(PluginConfig::maxRange.desc);
+	maxRangeAttachment = std::make_unique<APVTS::ComboBoxAttachment>(
+		processorRef.apvts, PluginConfig::maxRange.name, maxRangeBox);
+
+	lateOnlyButton.setTooltip(PluginConfig::lateOnly.desc);
+	lateOnlyAttachment = std::make_unique<APVTS::ButtonAttachment>(
+		processorRef.apvts, PluginConfig::lateOnly.name, lateOnlyButton);
+
+	grooveButton.setTooltip("Analyses a reference recording at the host tempo and plays its groove with the Groove shape.");
+	grooveButton.onClick = [this] { chooseGrooveReference(); };
+
+	updateProgramNames();
+	programBox.setTooltip("Program to play. Hosts switch programs with program changes; switching crossfades to the new settings.");
+	programBox.onChange = [this] {
+		if (programBox.getSelectedItemIndex() >= 0)
+			processorRef.setCurrentProgram(programBox.getSelectedItemIndex());
+	};
+
+	storeButton.setTooltip("Stores the current settings and seed in the selected program.");
+	storeButton.onClick = [this] {
+		const int index = processorRef.getCurrentProgram();
+		processorRef.storeProgram(index, processorRef.getProgramName(index));
+		updateProgramNames();
+	};
+
 	addAndMakeVisible(diagram);
+	diagram.addMouseListener(this, false);
+	addAndMakeVisible(shapeBox);
+	addAndMakeVisible(interpolationBox);
+	addAndMakeVisible(maxRangeBox);
+	addAndMakeVisible(lateOnlyButton);
+	addAndMakeVisible(grooveButton);
+	addAndMakeVisible(programBox);
+	addAndMakeVisible(storeButton);
+
+	if (Profiler::enabled) {
+		profilerButton.setTooltip("Shows what processBlock costs: block times, deadline misses and the load histogram.");
+		profilerButton.setClickingTogglesState(true);
+		profilerButton.onClick = [this] { profilerOverlay.setVisible(profilerButton.getToggleState()); };
+		addAndMakeVisible(profilerButton);
+		addChildComponent(profilerOverlay);
+	}
 	knobs.forEach([this] (KnobWithEditor& knob) {
 		addAndMakeVisible(knob);
 	});
 
-	startTimerHz(30);
+	// Hosts may create editors without showing them
+	initialiseForDisplay();
 }
 
 Editor::~Editor() {
-	openGLContext.detach();
+	cancelAnalysis = true;
+	if (shownOnce)
+		processorRef.telemetry.setConsumer(false, 1.0 / History::bucketsPerBeat);
+	diagram.removeMouseListener(this);
+	setOpenGL(false);
 	setLookAndFeel(nullptr);
 	processorRef.apvts.removeParameterListener(PluginConfig::range.name, this);
     processorRef.apvts.removeParameterListener(PluginConfig::center.name, this);
+	processorRef.apvts.removeParameterListener(PluginConfig::maxRange.name, this);
+	processorRef.apvts.removeParameterListener(PluginConfig::lateOnly.name, this);
+	processorRef.apvts.removeParameterListener(PluginConfig::shape.name, this);
+}
+
+void Editor::visibilityChanged() {
+	initialiseForDisplay();
+}
+
+void Editor::parentHierarchyChanged() {
+	initialiseForDisplay();
+}
+
+void Editor::initialiseForDisplay() {
+	if (shownOnce || !isShowing())
+		return;
+	shownOnce = true;
+
+	setOpenGL(resources->getRenderer() == UiResources::Renderer::openGL);
+	resources->showTooltips();
+
+	telemetryFrames.allocate(static_cast<size_t>(Telemetry::capacity), false);
+	// One telemetry bucket per History entry, whatever the width and zoom
+	processorRef.telemetry.setConsumer(true, 1.0 / History::bucketsPerBeat);
+}
+
+void Editor::setOpenGL(bool enabled) {
+	if (!enabled) {
+		if (openGLContext != nullptr)
+			openGLContext->detach();
+		openGLContext.reset();
+		return;
+	}
+
+	if (openGLContext == nullptr) {
+		openGLContext = std::make_unique<OpenGLContext>();
+		openGLContext->attachTo(*this);
+	}
+}
+
+void Editor::mouseDown(const MouseEvent& event) {
+	if (event.mods.isPopupMenu())
+		showContextMenu();
+}
+
+void Editor::showContextMenu() {
+	PopupMenu menu;
+	const bool openGL = openGLContext != nullptr;
+	menu.addItem("Draw with OpenGL", UiResources::canChooseRenderer(), openGL, [safeThis = SafePointer<Editor>(this), openGL] {
+		if (safeThis == nullptr)
+			return;
+		safeThis->resources->setRenderer(openGL ? UiResources::Renderer::software : UiResources::Renderer::openGL);
+		safeThis->setOpenGL(!openGL);
+		safeThis->repaint();
+	});
+	menu.showMenuAsync(PopupMenu::Options().withMousePosition());
 }
 
 void Editor::paint(Graphics& g) {
@@ -46,7 +162,7 @@ void Editor::resized() {
 	auto area = getLocalBounds().reduced(20);
 
 	float availableHeight = (float)area.getHeight();
-	float idealKnobWidth = (availableHeight / 3.0f);
+	float idealKnobWidth = (availableHeight / static_cast<float>(PluginConfig::Registry::size));
 	
 	float dynamicWidth = jmin(130.0f, idealKnobWidth);
 
@@ -55,17 +171,20 @@ void Editor::resized() {
 	knobsContainer.justifyContent = FlexBox::JustifyContent::spaceBetween;
 	
 	const FlexItem::Margin knobMargin = FlexItem::Margin(0, 0, 15, 0);
-	knobsContainer.items.add(FlexItem(knobs.range)
-		.withFlex(1.0f)
-		.withMinWidth(50.0f)
-		.withMargin(knobMargin));
-	knobsContainer.items.add(FlexItem(knobs.center)
-		.withFlex(1.0f)
-		.withMinWidth(50.0f)
-		.withMargin(knobMargin));
-	knobsContainer.items.add(FlexItem(knobs.speed)
-		.withFlex(1.0f)
-		.withMinWidth(50.0f));
+	knobs.forEach([&knobsContainer, &knobMargin] (KnobWithEditor& knob) {
+		knobsContainer.items.add(FlexItem(knob)
+			.withFlex(1.0f)
+			.withMinWidth(50.0f)
+			.withMargin(knobMargin));
+	});
+	for (auto* control : { static_cast<Component*>(&shapeBox), static_cast<Component*>(&interpolationBox), static_cast<Component*>(&maxRangeBox), static_cast<Component*>(&lateOnlyButton), static_cast<Component*>(&grooveButton), static_cast<Component*>(&programBox), static_cast<Component*>(&storeButton), static_cast<Component*>(&profilerButton) }) {
+		if (!control->isVisible())
+			continue;
+		knobsContainer.items.add(FlexItem(*control)
+			.withHeight(24.0f)
+			.withMinWidth(50.0f)
+			.withMargin(FlexItem::Margin(0, 0, 4, 0)));
+	}
 
 	FlexBox viewport;
 	viewport.flexDirection = FlexBox::Direction::row;
@@ -79,57 +198,45 @@ void Editor::resized() {
 		.withFlex(3.0f));
 
 	viewport.performLayout(area);
+
+	profilerOverlay.setBounds(diagram.getBounds().removeFromTop(140).removeFromRight(220).reduced(8));
 }
 
-void Editor::timerCallback() {
-	if (!isShowing()) return;
+void Editor::onVBlank() {
+	if (!shownOnce || !isShowing()) return;
 
 	if (limitsDirty.exchange(false)) {
 		updateDiagramLimits();
 	}
 
-	defer {
-		diagram.updateSmoothing();
-		diagram.repaint();
-	};
-
-	auto playHead = processorRef.getPlayHead();
-	if (playHead == nullptr) return;
-	auto position = playHead->getPosition();
-	if (!position.hasValue()) return;
-
-	double currentBeat = position->getPpqPosition().orFallback(0.0);
-
-	// 1. Calculate delta
-	double quartersTraveled = currentBeat - lastPlayHeadPos;
-
-	// Handle wrap-around/loops/stops
-	if (quartersTraveled <= 0 || quartersTraveled > 1.0) {
-		lastPlayHeadPos = currentBeat;
-		return;
+	// The host may have switched programs, which doesn't call the parameter listeners
+	if (programBox.getSelectedItemIndex() != processorRef.getCurrentProgram())
+		programBox.setSelectedItemIndex(processorRef.getCurrentProgram(), dontSendNotification);
+	if (programChangesSeen != processorRef.getProgramChangeCount()) {
+		programChangesSeen = processorRef.getProgramChangeCount();
+		limitsDirty = true;
+	}
+	// Groove's size follows the host tempo
+	if (!exactlyEqual(bpmSeen, processorRef.getLastBpm())) {
+		bpmSeen = processorRef.getLastBpm();
+		if (processorRef.getShape() == ModulationSources::Type::groove)
+			limitsDirty = true;
 	}
 
-	const double pixelsPerQuarter = double(diagram.getWidth()) / 8;
-
-	// Use a double for accumulation to avoid losing sub-pixel movement
-	static double pixelAccumulator = 0.0;
-	pixelAccumulator += quartersTraveled * pixelsPerQuarter;
-
-	int pixelsToShift = static_cast<int>(pixelAccumulator);
-
-	std::vector<float> valuesToDraw;
-	if (pixelsToShift > 0) {
-		pixelAccumulator -= pixelsToShift;
-		double beatStep = quartersTraveled / pixelsToShift;
-
-		for (int i = 1; i <= pixelsToShift; ++i) {
-			double sampleTime = lastPlayHeadPos + (beatStep * i);
-			valuesToDraw.push_back((float)processorRef.bezierGen.getValue(sampleTime));
-		}
-		diagram.shift(valuesToDraw); // Call once!
+	// Only what the audio thread applied, nothing is recomputed here
+	const int numFrames = processorRef.telemetry.read(telemetryFrames.get(), Telemetry::capacity);
+	for (int i = 0; i < numFrames; ++i) {
+		const auto& frame = telemetryFrames[i];
+		if (frame.isPlaying)
+			diagram.push(frame.minShiftMs, frame.maxShiftMs);
 	}
 
-	lastPlayHeadPos = currentBeat;
+	if (profilerOverlay.isVisible())
+		profilerOverlay.update(processorRef.profiler, Time::getMillisecondCounterHiRes());
+
+	// Stopped transport and settled limits: nothing new, no repaint
+	if (diagram.update(Time::getMillisecondCounterHiRes()))
+		diagram.repaint();
 }
 
 void Editor::parameterChanged(const String& parameterID, float newValue) {
@@ -137,8 +244,8 @@ void Editor::parameterChanged(const String& parameterID, float newValue) {
 }
 
 void Editor::updateDiagramLimits() {
-	float r = processorRef.parameters.range.parameter->load();
-	float c = processorRef.parameters.center.parameter->load();
+	float r = processorRef.getEffectiveRange(processorRef.parameters.get<PluginConfig::range>().parameter->load());
+	float c = processorRef.getEffectiveCenter(processorRef.parameters.get<PluginConfig::center>().parameter->load());
 
 
 	float theoreticalMax = 0.5 * r * (c + 1);
@@ -146,3 +253,55 @@ void Editor::updateDiagramLimits() {
 
 	diagram.setLimits(theoreticalMin, theoreticalMax);
 }
+
+// Empty programs keep the sound as it is when selected
+void Editor::updateProgramNames() {
+	programBox.clear(dontSendNotification);
+	for (int i = 0; i < processorRef.getNumPrograms(); ++i)
+		programBox.addItem(processorRef.getProgramName(i) + (processorRef.isProgramStored(i) ? "" : " (empty)"), i + 1);
+	programBox.setSelectedItemIndex(processorRef.getCurrentProgram(), dontSendNotification);
+}
+
+void Editor::chooseGrooveReference() {
+	grooveChooser = std::make_unique<FileChooser>("Reference recording", File(), "*.wav;*.aif;*.aiff;*.flac");
+	grooveChooser->launchAsync(FileBrowserComponent::openMode | FileBrowserComponent::canSelectFiles, [this] (const FileChooser& chooser) {
+		const auto file = chooser.getResult();
+		if (!file.existsAsFile())
+			return;
+
+		GrooveAnalyzer::Settings settings;
+		settings.bpm = processorRef.getLastBpm();
+		grooveButton.setEnabled(false);
+		grooveButton.setButtonText("Analysing...");
+
+		if (analysisPool == nullptr)
+			analysisPool = std::make_unique<ThreadPool>(1);
+		analysisPool->addJob([this, file, settings, safeThis = SafePointer<Editor>(this)] {
+			GrooveAnalyzer::Result result;
+			const auto error = GrooveAnalyzer::analyzeFile(file, settings, result, &cancelAnalysis);
+
+			MessageManager::callAsync([safeThis, result, error] {
+				if (safeThis != nullptr)
+					safeThis->grooveAnalysed(result, error);
+			});
+		});
+	});
+}
+
+void Editor::grooveAnalysed(const GrooveAnalyzer::Result& result, const String& error) {
+	grooveButton.setEnabled(true);
+	grooveButton.setButtonText("Groove...");
+
+	if (error.isNotEmpty()) {
+		grooveButton.setTooltip("Analysis failed: " + error);
+		return;
+	}
+
+	processorRef.setGrooveMap(result.map);
+	limitsDirty = true;
+	if (auto* shape = processorRef.apvts.getParameter(PluginConfig::shape.name))
+		shape->setValueNotifyingHost(shape->convertTo0to1(static_cast<float>(static_cast<int>(ModulationSources::Type::groove))));
+
+	grooveButton.setTooltip(String(result.numOnsets) + " onsets over a " + String(result.map.getNumBeats())
+		+ " beat pattern. Click to analyse another reference.");
+}
@@ -1,41 +1,49 @@
 // PluginEditor.h
 #pragma once
 
-#include <functional>
 #include <atomic>
 #include "KnobWithEditor.h"
 #include "Diagram.h"
+#include "UiResources.h"
+#include "ProfilerOverlay.h"
 #include "PluginProcessor.h"
 #include "PluginConfig.h"
+#include "GrooveAnalyzer.h"
 #include "Types.h"
 
+template <const ParameterSettings& Settings>
+struct Knob : KnobWithEditor {
+	explicit Knob(APVTS& apvts) : KnobWithEditor(apvts, Settings) {}
+};
+
 struct Knobs {
-	KnobWithEditor range;
-	KnobWithEditor center;
-	KnobWithEditor speed;
+	PluginConfig::Registry::Tuple<Knob> items;
 
 	Knobs(APVTS& apvts)
-			: range(apvts, PluginConfig::range)
-			, center(apvts, PluginConfig::center)
-			, speed(apvts, PluginConfig::speed)
-		{
+			: items(PluginConfig::Registry::make<Knob>(apvts)) {
 	}
 
-	void forEach(std::function<void(KnobWithEditor&)> callback) {
-		callback(range);
-		callback(center);
-		callback(speed);
+	template <const ParameterSettings& Settings>
+	Knob<Settings>& get() { return std::get<Knob<Settings>>(items); }
+
+	template <typename Callback>
+	void forEach(Callback&& callback) {
+		std::apply([&callback] (auto&... knob) { (callback(knob), ...); }, items);
 	}
 };
 
 //==============================================================================
-class Editor : public AudioProcessorEditor, public Timer, public APVTS::Listener {
+class Editor : public AudioProcessorEditor, public APVTS::Listener {
 	Humanizer& processorRef;
-	ModernLookAndFeel modernLook;
-	OpenGLContext openGLContext;
+	// Drained from processorRef.telemetry every frame
+	HeapBlock<TelemetryFrame> telemetryFrames;
+	SharedResourcePointer<UiResources> resources;
+	// Created when the editor is first shown, so hidden editors and scans don't pay for them
+	std::unique_ptr<OpenGLContext> openGLContext;
+	bool shownOnce = false;
 	std::atomic<bool> limitsDirty;
-	double lastPlayHeadPos = 0;
-	std::unique_ptr<juce::TooltipWindow> tooltipWindow { std::make_unique<juce::TooltipWindow> (this) };
+	int programChangesSeen = 0;
+	double bpmSeen = 0.0;
 
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Editor)
 public:
@@ -45,9 +53,46 @@ public:
 	//==============================================================================
 	void paint (Graphics&) override;
 	void resized() override;
-	void timerCallback() override;
+	void visibilityChanged() override;
+	void parentHierarchyChanged() override;
+	// Called on every display refresh
+	void onVBlank();
 	Knobs knobs;
 	Diagram diagram;
+	ComboBox shapeBox;
+	std::unique_ptr<APVTS::ComboBoxAttachment> shapeAttachment;
+	ComboBox interpolationBox;
+	std::unique_ptr<APVTS::ComboBoxAttachment> interpolationAttachment;
+	ComboBox maxRangeBox;
+	std::unique_ptr<APVTS::ComboBoxAttachment> maxRangeAttachment;
+	ToggleButton lateOnlyButton { PluginConfig::lateOnly.name };
+	std::unique_ptr<APVTS::ButtonAttachment> lateOnlyAttachment;
+	TextButton grooveButton { "Groove..." };
+	ComboBox programBox;
+	TextButton storeButton { "Store" };
+	// Profiling builds only
+	TextButton profilerButton { "CPU" };
+	ProfilerOverlay profilerOverlay;
 	void parameterChanged (const juce::String& parameterID, float newValue) override;
     void updateDiagramLimits();
+
+private:
+	// Reference analysis runs on its own thread, started by the first analysis.
+	// The pool is declared after the flag, so it waits for a cancelled job
+	// before the flag goes away.
+	std::unique_ptr<FileChooser> grooveChooser;
+	std::atomic<bool> cancelAnalysis { false };
+	std::unique_ptr<ThreadPool> analysisPool;
+
+	void initialiseForDisplay();
+	void setOpenGL(bool enabled);
+	// Right click on the background or the diagram
+	void mouseDown(const MouseEvent& event) override;
+	void showContextMenu();
+	void updateProgramNames();
+	void chooseGrooveReference();
+	void grooveAnalysed(const GrooveAnalyzer::Result& result, const String& error);
+
+	// Last member, so it is detached before anything it touches is destroyed
+	VBlankAttachment vblank { this, [this] { onVBlank(); } };
 };
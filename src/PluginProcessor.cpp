@@ -8,26 +8,57 @@
 
 Humanizer::Humanizer()
 	: AudioProcessor (BusesProperties()
+				#if ! HUMANIZER_MIDI_EFFECT
 				   .withInput("Input", AudioChannelSet::stereo(), true)
-				   .withOutput ("Output", AudioChannelSet::stereo(), true))
+				   .withOutput ("Output", AudioChannelSet::stereo(), true)
+				#endif
+				   )
 	, apvts(
 		* this,
 		nullptr,
 		"PARAMETERS",
 		createParameterLayout())
-	, bezierGen(* this, Random::getSystemRandom().nextInt()) {
-	parameters.forEach([this](Parameter& p) {
+	, curveGen(* this, Random::getSystemRandom().nextInt()) {
+	parameters.forEach([this](auto& p) {
 		p.link(apvts, getSampleRate());
 	});
+	interpolation = apvts.getRawParameterValue(PluginConfig::interpolation.name);
+	shape = apvts.getRawParameterValue(PluginConfig::shape.name);
+	maxRange = apvts.getRawParameterValue(PluginConfig::maxRange.name);
+	lateOnly = apvts.getRawParameterValue(PluginConfig::lateOnly.name);
+	for (int i = 0; i < StateFormat::numParameters; ++i) {
+		stateParameters[i] = apvts.getParameter(StateFormat::parameters[i]->name);
+		stateValues[i] = apvts.getRawParameterValue(StateFormat::parameters[i]->name);
+	}
+
+	// These change the latency or the size of the delay line
+	apvts.addParameterListener(PluginConfig::maxRange.name, this);
+	apvts.addParameterListener(PluginConfig::lateOnly.name, this);
+	apvts.addParameterListener(PluginConfig::center.name, this);
+	apvts.addParameterListener(PluginConfig::interpolation.name, this);
+	// Smoothed parameters are queued as events at the time they changed.
+	// Center is listened to already, adding it again is ignored.
+	parameters.forEach([this] (auto& p) {
+		apvts.addParameterListener(p.settings.name, this);
+	});
+	startTimerHz(updateRateHz);
 }
 
 Humanizer::~Humanizer() {
+	stopTimer();
+	apvts.removeParameterListener(PluginConfig::maxRange.name, this);
+	apvts.removeParameterListener(PluginConfig::lateOnly.name, this);
+	apvts.removeParameterListener(PluginConfig::center.name, this);
+	apvts.removeParameterListener(PluginConfig::interpolation.name, this);
+	parameters.forEach([this] (auto& p) {
+		apvts.removeParameterListener(p.settings.name, this);
+	});
 }
 
 AudioProcessorValueTreeState::ParameterLayout Humanizer::createParameterLayout() {
 	std::vector<std::unique_ptr<RangedAudioParameter>> params;
 
-	parameters.forEach([&params] (Parameter& parameter) {
+	parameters.forEach([&params] (auto& parameter) {
 		params.push_back(std::make_unique<AudioParameterFloat>(
 			ParameterID { parameter.settings.name, 1 },
 			parameter.settings.name,
@@ -36,16 +67,47 @@ AudioProcessorValueTreeState::ParameterLayout Humanizer::createParameterLayout()
 		));
 	});
 
+	params.push_back(std::make_unique<AudioParameterChoice>(
+		ParameterID { PluginConfig::interpolation.name, 1 },
+		PluginConfig::interpolation.name,
+		PluginConfig::interpolationTypes,
+		static_cast<int>(PluginConfig::interpolation.defaultVal)
+	));
+
+	params.push_back(std::make_unique<AudioParameterChoice>(
+		ParameterID { PluginConfig::shape.name, 1 },
+		PluginConfig::shape.name,
+		PluginConfig::shapeTypes,
+		static_cast<int>(PluginConfig::shape.defaultVal),
+		AudioParameterChoiceAttributes().withAutomatable(false)
+	));
+
+	params.push_back(std::make_unique<AudioParameterChoice>(
+		ParameterID { PluginConfig::maxRange.name, 1 },
+		PluginConfig::maxRange.name,
+		PluginConfig::maxRangeChoices,
+		static_cast<int>(PluginConfig::maxRange.defaultVal),
+		AudioParameterChoiceAttributes().withAutomatable(false)
+	));
+
+	params.push_back(std::make_unique<AudioParameterBool>(
+		ParameterID { PluginConfig::lateOnly.name, 1 },
+		PluginConfig::lateOnly.name,
+		PluginConfig::lateOnly.defaultVal > 0.5f,
+		AudioParameterBoolAttributes().withAutomatable(false)
+	));
+
 	return { params.begin(), params.end() };
 }
 
 bool Humanizer::isBusesLayoutSupported (const BusesLayout& layouts) const {
-	// This is the place where you check if the layout is supported.
-	// In this template code we only support mono or stereo.
-	// Some plugin hosts, such as certain GarageBand versions, will only
-	// load plugins that support stereo bus layouts.
-	if (layouts.getMainOutputChannelSet() != AudioChannelSet::mono()
-		&& layouts.getMainOutputChannelSet() != AudioChannelSet::stereo())
+	// The MIDI effect has no audio to delay
+	if (isMidiEffect())
+		return true;
+
+	// Any layout works (mono up to immersive and Ambisonic beds),
+	// as long as input and output match.
+	if (layouts.getMainOutputChannelSet().isDisabled())
 		return false;
 
 	if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
@@ -54,84 +116,441 @@ bool Humanizer::isBusesLayoutSupported (const BusesLayout& layouts) const {
 	return true;
 }
 
+float Humanizer::getLatencyBudgetMs() const {
+	const int index = maxRange != nullptr ? roundToInt(maxRange->load()) : static_cast<int>(PluginConfig::maxRange.defaultVal);
+	return PluginConfig::maxRangeMs[jlimit(0, PluginConfig::maxRangeChoices.size() - 1, index)];
+}
+
+void Humanizer::setGrooveMap(const GrooveMap& map) {
+	suspendProcessing(true);
+	grooveMap = map;
+	suspendProcessing(false);
+}
+
+ModulationSources::Type Humanizer::getShape() const {
+	const int index = shape != nullptr ? roundToInt(shape->load()) : 0;
+	return static_cast<ModulationSources::Type>(jlimit(0, PluginConfig::shapeTypes.size() - 1, index));
+}
+
+Interpolators::Type Humanizer::getInterpolation() const {
+	const int index = interpolation != nullptr ? roundToInt(interpolation->load()) : 0;
+	return static_cast<Interpolators::Type>(jlimit(0, PluginConfig::interpolationTypes.size() - 1, index));
+}
+
+bool Humanizer::isLateOnly() const {
+	return lateOnly != nullptr && lateOnly->load() > 0.5f;
+}
+
+float Humanizer::getEffectiveRange(float range) const {
+	// At 0, Groove plays the offsets as measured at the host tempo; above, Range sets its depth
+	if (range <= 0.0f && getShape() == ModulationSources::Type::groove)
+		range = grooveMap.getRangeMs(lastBpm.load());
+
+	// Until a larger budget has been prepared, the old one still limits the delay line
+	const float budget = preparedBudgetMs > 0.0f ? jmin(getLatencyBudgetMs(), preparedBudgetMs.load()) : getLatencyBudgetMs();
+	return jmin(range, budget);
+}
+
+float Humanizer::getEffectiveCenter(float center) const {
+	// With the curve centered at +1, range * 0.5 * (center + curve) is never negative
+	return isLateOnly() ? 1.0f : center;
+}
+
+// Latency needed to shift the whole budget early around Center.
+// Depends on the budget rather than Range, so automating Range doesn't change it.
 double Humanizer::getRequiredLatencyMs() const {
-	float r = parameters.range.parameter->load();
-	float c = parameters.center.parameter->load();
-	float worstCase = -r * 0.5 * (c - 1.0);
-	worstCase = jmax(0.0f, worstCase);
-	return worstCase;
+	if (isLateOnly())
+		return 0.0;
+
+	float c = jlimit(-1.0f, 1.0f, parameters.get<PluginConfig::center>().parameter->load());
+	return getLatencyBudgetMs() * 0.5 * (1.0 - c);
+}
+
+void Humanizer::prepareDelayLine(double sampleRate, int samplesPerBlock) {
+	// latency + range * 0.5 * (center + curve) never exceeds the budget,
+	// so that is all the delay line has to hold at this rate.
+	// The kernel adds its block and taps and rounds up to a power of two.
+	const float budgetMs = getLatencyBudgetMs();
+	int maxSamplesNeeded = static_cast<int>(std::ceil((budgetMs / 1000.0) * sampleRate));
+
+	offlineTierWanted = wantsOfflineTier();
+	if (!isMidiEffect()) {
+		// processBlock adds the lookahead on top. Without the memory for it, the
+		// audio is left dry and no latency is reported.
+		const bool prepared = delayKernel.prepare(getTotalNumOutputChannels(), maxSamplesNeeded, samplesPerBlock);
+
+		// Falls back to the real-time tier if it can't be prepared
+		if (!prepared || !offlineTierWanted || !oversampledDelay.prepare(getTotalNumOutputChannels(), maxSamplesNeeded, samplesPerBlock))
+			oversampledDelay.release();
+	}
+	offlineTier = oversampledDelay.isPrepared();
+	preparedBudgetMs = budgetMs;
+	preparedBlockSize = samplesPerBlock;
+}
+
+bool Humanizer::wantsOfflineTier() const {
+	return isNonRealtime() && !isLateOnly() && !isMidiEffect();
+}
+
+void Humanizer::setNonRealtime(bool isNonRealtime) noexcept {
+	AudioProcessor::setNonRealtime(isNonRealtime);
+	latencyChanged = true;
+}
+
+void Humanizer::reportLatency(double sampleRate) {
+	if (!isMidiEffect() && !delayKernel.isPrepared()) {
+		reportedLatencyMs = 0.0f;
+		reportedLookahead = 0;
+		setLatencySamples(0);
+		return;
+	}
+
+	const double latencyMs = jmin(getRequiredLatencyMs(), static_cast<double>(preparedBudgetMs.load()));
+	const int latencySamples = roundToInt((latencyMs / 1000.0) * sampleRate);
+
+	// Only the selected interpolator's lookahead, Linear has none
+	const int lookahead = isMidiEffect() ? 0 : DelayKernel::getLookahead(getInterpolation());
+
+	// Only the offline tier's filters need the padding
+	const int padding = offlineTier ? OversampledDelay::getLatencyPadding() : 0;
+
+	// The audio thread delays by exactly what the host compensates.
+	// Late Only reports none: its lookahead stays in as a minimum delay.
+	reportedLatencyMs = static_cast<float>(latencySamples * 1000.0 / sampleRate);
+	reportedLookahead = lookahead;
+	setLatencySamples(latencySamples + (isLateOnly() ? 0 : lookahead + padding));
+}
+
+// Message thread only
+void Humanizer::updateLatency() {
+	const double sampleRate = getSampleRate();
+	if (sampleRate <= 0.0 || preparedBlockSize == 0)
+		return; // prepareToPlay reports it
+
+	if (getLatencyBudgetMs() > preparedBudgetMs || wantsOfflineTier() != offlineTierWanted) {
+		// The delay line has to grow or switch tiers: keep the audio callback out while it does
+		suspendProcessing(true);
+		prepareDelayLine(sampleRate, preparedBlockSize);
+		suspendProcessing(false);
+	}
+
+	reportLatency(sampleRate);
+}
+
+void Humanizer::parameterChanged(const String& parameterID, float newValue) {
+	ignoreUnused(newValue);
+	const int index = parameters.indexOf(parameterID);
+	if (index >= 0) {
+		// Hosts that automate on the audio thread do so before the block, so it starts there
+		const bool onAudioThread = Thread::getCurrentThreadId() == audioThread.load();
+		changeTicks[index] = onAudioThread ? noTicks : Time::getHighResolutionTicks();
+		changedParameters.fetch_or(uint32(1) << index);
+	}
+
+	// May be called on the audio thread, where posting a message could lock,
+	// so the timer picks the change up on the message thread
+	if (index < 0 || parameterID == PluginConfig::center.name)
+		latencyChanged = true;
+}
+
+void Humanizer::timerCallback() {
+	// Publishing a program can change the latency too, so it goes first
+	if (programApplied.exchange(false))
+		publishProgram();
+	if (latencyChanged.exchange(false))
+		updateLatency();
 }
 
 void Humanizer::prepareToPlay(double sampleRate, int samplesPerBlock) {
-	parameters.forEach([&sampleRate] (Parameter& parameter) {
-		parameter.smoothed.reset(sampleRate, PluginConfig::ramptime);
+	parameters.forEach([sampleRate, samplesPerBlock] (auto& parameter) {
+		parameter.prepare(sampleRate, samplesPerBlock);
 	});
 
-	// 1. Calculate the Worst Case Latency (Max Range + Min Center)
-	// We use the STATIC config limits, not the current parameter value.
-	float maxPossibleRange = PluginConfig::range.max; 
-
-	// Calculate max latency compensation needed if center was at 0.0
-	// formula: -range * 0.5 * (center - 1.0) -> maxes out when center is 0
-	float maxLatencyMs = maxPossibleRange * 0.5f; 
+	prepareDelayLine(sampleRate, samplesPerBlock);
+	reportLatency(sampleRate);
+	parameterEvents.prepare(maxParameterEvents);
+	beatClock.prepare(sampleRate);
+	programFade.prepare(getTotalNumOutputChannels());
+
+	if (isMidiEffect()) {
+		midiScheduler.prepare();
+		// Room for the whole queue plus a block of incoming events, so collecting them never allocates
+		midiOutput.ensureSize(static_cast<size_t>(MidiScheduler::capacity) * 2 * 16);
+		midiClock = 0;
+	}
 
-	int latencySamples = static_cast<int>((maxLatencyMs / 1000.0) * sampleRate);
-	setLatencySamples(latencySamples);
+	curveBlock.assign(static_cast<size_t>(delayKernel.getMaximumBlockSize()), 0.0f);
+	delayBlock.assign(curveBlock.size(), 0.0f);
 
-	dsp::ProcessSpec spec {
-		sampleRate,
-		static_cast<uint32>(samplesPerBlock),
-		static_cast<uint32>(getTotalNumOutputChannels()),
-	};
+	const int numChannels = getTotalNumOutputChannels();
+	const int laneStride = CurveGenerator::getLaneStride(jmin(numChannels, CurveGenerator::maxLanes));
+	laneBlock.assign(curveBlock.size() * static_cast<size_t>(laneStride), 0.0f);
+	channelDelayBlock.assign(curveBlock.size() * static_cast<size_t>(numChannels), 0.0f);
+	channelDelays.resize(static_cast<size_t>(numChannels));
+	for (int ch = 0; ch < numChannels; ++ch)
+		channelDelays[static_cast<size_t>(ch)] = channelDelayBlock.data() + curveBlock.size() * static_cast<size_t>(ch);
+}
 
-	delayLine.prepare(spec);
+// delay = latency + range * 0.5 * (center + curve), in samples.
+// Uses this chunk's smoothed range and center, so fillBlock must have run.
+void Humanizer::computeDelays(float* delays, const float* curve, int numSamples, float requiredLatencyMs) {
+	const float sr = static_cast<float>(getSampleRate());
+	const float* range = parameters.get<PluginConfig::range>().values.get();
+	const float* center = parameters.get<PluginConfig::center>().values.get();
+
+	FloatVectorOperations::add(delays, curve, center, numSamples);
+	FloatVectorOperations::multiply(delays, range, numSamples);
+	FloatVectorOperations::multiply(delays, 0.5f / 1000.0f * sr, numSamples);
+	FloatVectorOperations::add(delays, requiredLatencyMs / 1000.0f * sr, numSamples);
+}
 
-	float absoluteMaxDelayMs = maxLatencyMs + maxPossibleRange;
+bool Humanizer::addParameterEvent(const ParameterSettings& settings, int sampleOffset, float value) {
+	const int index = parameters.indexOf(settings);
+	if (index < 0)
+		return false;
 
-	int maxSamplesNeeded = static_cast<int>((absoluteMaxDelayMs / 1000.0) * sampleRate);
+	return parameterEvents.add({ jmax(0, sampleOffset), index, value });
+}
 
-	delayLine.setMaximumDelayInSamples(maxSamplesNeeded + 1024);
+// A change made while the previous block ran lands at the same distance into
+// this one, so changes keep their spacing a block later. Parameters the caller
+// already gave events keep only those.
+void Humanizer::queueParameterChanges(int numSamples) {
+	const int64 blockTicks = Time::getHighResolutionTicks();
+	const int64 previousTicks = lastBlockTicks;
+	lastBlockTicks = blockTicks;
+
+	const uint32 changed = changedParameters.exchange(0);
+	if (changed == 0 || numSamples <= 0)
+		return;
+
+	const uint32 eventMask = parameterEvents.getParameterMask();
+	const double samplesPerTick = getSampleRate() / static_cast<double>(Time::getHighResolutionTicksPerSecond());
+	parameters.forEachIndexed([&] (auto& p, int index) {
+		const uint32 bit = uint32(1) << index;
+		if (p.parameter == nullptr || (changed & bit) == 0 || (eventMask & bit) != 0)
+			return;
+
+		const int64 ticks = changeTicks[index].load();
+		const double offset = ticks == noTicks || previousTicks == 0 ? 0.0
+			: static_cast<double>(ticks - previousTicks) * samplesPerTick;
+		parameterEvents.add({ jlimit(0, numSamples - 1, static_cast<int>(offset)), index, p.parameter->load() });
+	});
 }
 
 void Humanizer::processBlock(AudioBuffer<float>& buffer, MidiBuffer& midiMessages) {
-	parameters.forEach([] (Parameter& p) {
-		if (p.parameter) // Always check for null!
+	const Profiler::Scope profile(profiler, buffer.getNumSamples(), getSampleRate());
+	audioThread = Thread::getCurrentThreadId();
+	queueParameterChanges(buffer.getNumSamples());
+	parameterEvents.clampOffsets(jmax(0, buffer.getNumSamples() - 1));
+
+	// Parameters with events this block follow those instead
+	PresetBank::Snapshot program;
+	if (presetBank.pull(program))
+		applyProgram(program);
+
+	const uint32 eventMask = parameterEvents.getParameterMask();
+	parameters.forEachIndexed([eventMask] (auto& p, int index) {
+		if (p.parameter && (eventMask & (uint32(1) << index)) == 0) // Always check for null!
 			p.smoothed.setTargetValue(p.parameter->load());
 	});
 
-	double bpm = 120.0;
-	double currentBeat = 0.0;
+	const int numSamples = buffer.getNumSamples();
 	float sr = getSampleRate();
-	float requiredLatencyMs = getRequiredLatencyMs();
-	double samplesPerBeat = (60.0 / bpm) * sr;
-	double beatIncrement = 1.0 / samplesPerBeat;
-
-	auto playHead = getPlayHead();
-	if (playHead != nullptr) {
-		if (auto position = playHead->getPosition()) {
-			bpm = position->getBpm().orFallback(120.0);
-			currentBeat = position->getPpqPosition().orFallback(0);
-		}
+	// What the host compensates, not what the current Center would need
+	float requiredLatencyMs = reportedLatencyMs.load();
+
+	beatClock.advance(getPlayHead(), numSamples);
+	const double bpm = beatClock.getBpm();
+	lastBpm = bpm;
+	const bool isPlaying = beatClock.getIsPlaying();
+	const double beatIncrement = beatClock.getIncrement();
+
+	if (isMidiEffect()) {
+		parameterEvents.clear();
+		processMidi(midiMessages, numSamples, requiredLatencyMs);
+		return;
+	}
+
+	const auto interpolationType = getInterpolation();
+
+	// Bypassed while the delay line has no memory
+	const int chunkSize = static_cast<int>(curveBlock.size());
+	if (chunkSize == 0 || !delayKernel.isPrepared()) {
+		parameterEvents.clear();
+		return;
 	}
 
-	for (int sample = 0; sample < buffer.getNumSamples(); ++sample) {
-		parameters.forEach([] (Parameter& p) {
-			if (p.parameter)
-				p.smoothed.getNextValue();
+	const int numChannels = jmin(buffer.getNumChannels(), static_cast<int>(channelDelays.size()));
+	const int numLanes = jmin(numChannels, CurveGenerator::maxLanes);
+	const int laneStride = CurveGenerator::getLaneStride(numLanes);
+	auto& spread = parameters.get<PluginConfig::spread>();
+	const float rangeLimit = getEffectiveRange(PluginConfig::range.max);
+	// What a Range of 0 plays, only the Groove shape has one
+	const float grooveRange = getEffectiveRange(0.0f);
+	const bool pinCenter = isLateOnly();
+	const bool sendTelemetry = telemetry.isActive();
+	const float msPerSample = 1000.0f / sr;
+	// The tier the delay line was prepared and the latency reported for
+	const bool useOfflineTier = offlineTier.load();
+
+	// The lookahead the latency was reported for. Until the report follows a new
+	// interpolator, the kernel clamps short delays to what that one needs.
+	const float lookahead = static_cast<float>(reportedLookahead.load());
+	if (useOfflineTier)
+		oversampledDelay.setDelayOffset(lookahead);
+	else
+		delayKernel.setDelayOffset(lookahead);
+
+	auto& speed = parameters.get<PluginConfig::speed>();
+	int nextEvent = 0;
+
+	// Hosts may send more than samplesPerBlock, so work in chunks of the curve buffer.
+	// Chunks also end at every parameter event, so changes land on their sample.
+	for (int chunkStart = 0, chunkLength = 0; chunkStart < numSamples; chunkStart += chunkLength) {
+		for (; nextEvent < parameterEvents.size() && parameterEvents[nextEvent].sampleOffset <= chunkStart; ++nextEvent) {
+			const auto& event = parameterEvents[nextEvent];
+			parameters.forEachIndexed([&event] (auto& p, int index) {
+				if (index == event.parameter)
+					p.smoothed.setTargetValue(event.value);
+			});
+		}
+
+		int chunkEnd = jmin(chunkStart + chunkSize, numSamples);
+		if (nextEvent < parameterEvents.size())
+			chunkEnd = jmin(chunkEnd, parameterEvents[nextEvent].sampleOffset);
+		// A chunk is one straight piece of the beat ramp, loops wrap between chunks
+		chunkEnd = jmin(chunkEnd, beatClock.segmentEnd(chunkStart, numSamples));
+		// The curve reads Speed once per chunk, so follow its ramp in short steps
+		if (speed.smoothed.isSmoothing())
+			chunkEnd = jmin(chunkEnd, chunkStart + speedRampChunk);
+
+		chunkLength = chunkEnd - chunkStart;
+		const double chunkBeat = beatClock.beatAt(chunkStart);
+
+		// Checked before fillBlock moves the smoother, so a ramp down to 0 finishes on the per-channel path.
+		// Channels may have been apart before a program change, so its fade runs per channel too.
+		const bool linked = numChannels < 2
+			|| (spread.smoothed.getCurrentValue() <= 0.0f && !spread.smoothed.isSmoothing() && !programFade.isActive());
+
+		// Before fillBlock, so the curve uses Speed at the start of the chunk
+		if (linked)
+			curveGen.generateBlock(chunkBeat, beatIncrement, curveBlock.data(), chunkLength);
+		else
+			curveGen.generateLanes(chunkBeat, beatIncrement, laneBlock.data(), numLanes, chunkLength);
+
+		parameters.forEach([chunkLength] (auto& p) {
+			p.fillBlock(chunkLength);
 		});
 
-		float rawDelayMs = bezierGen.getValue(currentBeat);
+		// Range clamped to the budget; Late Only pins Center so no delay goes early
+		float* range = parameters.get<PluginConfig::range>().values.get();
+		if (grooveRange > 0.0f)
+			for (int i = 0; i < chunkLength; ++i)
+				if (range[i] <= 0.0f)
+					range[i] = grooveRange;
+		FloatVectorOperations::min(range, range, rangeLimit, chunkLength);
+		if (pinCenter)
+			FloatVectorOperations::fill(parameters.get<PluginConfig::center>().values.get(), 1.0f, chunkLength);
+
+		if (linked) {
+			computeDelays(delayBlock.data(), curveBlock.data(), chunkLength, requiredLatencyMs);
+			if (programFade.isActive())
+				programFade.apply(0, delayBlock.data(), chunkLength);
+			programFade.advance(chunkLength);
+			programFade.trackAll(delayBlock.data(), chunkLength);
+			programFade.tracked();
+			if (sendTelemetry)
+				telemetry.write(chunkBeat, beatIncrement, bpm, isPlaying, delayBlock.data(), msPerSample, requiredLatencyMs, chunkLength);
+			if (useOfflineTier)
+				oversampledDelay.process(buffer, chunkStart, chunkLength, delayBlock.data());
+			else
+				delayKernel.process(buffer, chunkStart, chunkLength, delayBlock.data(), interpolationType);
+			continue;
+		}
+
+		// One curve per channel; lane 0 is the linked curve, Spread blends towards each channel's own
+		const float* amount = spread.values.get();
+
+		for (int ch = 0; ch < numChannels; ++ch) {
+			const float* lanes = laneBlock.data();
+			const int lane = ch % numLanes;
+			float* curve = curveBlock.data();
 
-		currentBeat += beatIncrement;
-		float delayMs = requiredLatencyMs + rawDelayMs;
-		float delayInSamples = delayMs / 1000.0 * sr;
-		delayLine.setDelay(delayInSamples);
+			for (int i = 0; i < chunkLength; ++i) {
+				const float shared = lanes[i * laneStride];
+				curve[i] = shared + amount[i] * (lanes[i * laneStride + lane] - shared);
+			}
 
-		for (int ch = 0; ch < buffer.getNumChannels(); ++ ch) {
-			delayLine.pushSample(ch, buffer.getSample(ch, sample));
-			buffer.setSample(ch, sample, delayLine.popSample(ch));
+			float* delays = channelDelayBlock.data() + static_cast<size_t>(ch * chunkSize);
+			computeDelays(delays, curve, chunkLength, requiredLatencyMs);
+			if (programFade.isActive())
+				programFade.apply(ch, delays, chunkLength);
+			programFade.track(ch, delays, chunkLength);
 		}
+		programFade.advance(chunkLength);
+		programFade.tracked();
+
+		// The diagram follows the first channel
+		if (sendTelemetry)
+			telemetry.write(chunkBeat, beatIncrement, bpm, isPlaying, channelDelays[0], msPerSample, requiredLatencyMs, chunkLength);
+		if (useOfflineTier)
+			oversampledDelay.processPerChannel(buffer, chunkStart, chunkLength, channelDelays.data());
+		else
+			delayKernel.processPerChannel(buffer, chunkStart, chunkLength, channelDelays.data(), interpolationType);
 	}
+
+	parameterEvents.clear();
+}
+
+// Moves every note by the curve at its own timestamp, so only a few curve
+// values are evaluated per block. Other events are only delayed by the
+// reported latency, which keeps them in line with the notes around them.
+// SysEx is passed on where it is, it is too large for the queue.
+void Humanizer::processMidi(MidiBuffer& midiMessages, int numSamples, float requiredLatencyMs) {
+	// Notes are discrete, so there is nothing to smooth between them
+	parameters.forEach([] (auto& p) {
+		if (p.parameter)
+			p.smoothed.setCurrentAndTargetValue(p.parameter->load());
+	});
+
+	const double samplesPerMs = getSampleRate() / 1000.0;
+	const int64 latency = roundToInt(requiredLatencyMs * samplesPerMs);
+	midiOutput.clear();
+
+	for (const auto metadata : midiMessages) {
+		const uint8* data = metadata.data;
+		const int64 now = midiClock + metadata.samplePosition;
+		const bool isNote = metadata.numBytes == 3 && ((data[0] & 0xf0) == 0x90 || (data[0] & 0xf0) == 0x80);
+
+		int64 time = now + latency;
+		if (isNote) {
+			const double beat = beatClock.beatAt(metadata.samplePosition);
+			const int64 shift = static_cast<int64>(std::round(curveGen.getValue(beat) * samplesPerMs));
+			// The latency covers the earliest shift, this only guards rounding
+			time = midiScheduler.orderForKey(data, jmax(now, time + shift));
+		}
+
+		if (!midiScheduler.schedule(data, metadata.numBytes, time))
+			midiOutput.addEvent(data, metadata.numBytes, metadata.samplePosition);
+	}
+
+	// No per-sample delays here, so the curve is sampled once per bucket of each ramp segment
+	if (telemetry.isActive()) {
+		for (int i = 0; i < beatClock.getNumSegments(); ++i) {
+			const auto& segment = beatClock.getSegment(i);
+			const int length = beatClock.segmentEnd(segment.offset, numSamples) - segment.offset;
+			telemetry.writeSampled(segment.startBeat, beatClock.getIncrement(), beatClock.getBpm(), beatClock.getIsPlaying(), length, [this] (double beat) {
+				return static_cast<float>(curveGen.getValue(beat));
+			});
+		}
+	}
+
+	// Copied rather than swapped, so midiOutput keeps the room prepareToPlay gave it
+	midiScheduler.emit(midiOutput, midiClock, numSamples);
+	midiMessages.clear();
+	midiMessages.addEvents(midiOutput, 0, -1, 0);
+	midiClock += numSamples;
 }
 
 bool Humanizer::hasEditor() const {
@@ -144,13 +563,115 @@ AudioProcessorEditor * Humanizer::createEditor() {
 
 //==============================================================================
 void Humanizer::getStateInformation(MemoryBlock& destData) {
-	auto state = apvts.copyState();
-	state.setProperty("seed", bezierGen.seed, nullptr);
-	std::unique_ptr<XmlElement> xml(state.createXml());
-	copyXmlToBinary(*xml, destData);
+	StateFormat::State state;
+	for (int i = 0; i < StateFormat::numParameters; ++i)
+		state.values[i] = stateParameters[i]->convertFrom0to1(stateParameters[i]->getValue());
+	state.seed = curveGen.seed;
+	if (!grooveMap.isEmpty())
+		grooveMap.writeTo(state.groove);
+
+	state.program = presetBank.getSelected();
+	for (int slot = 0; slot < PresetBank::numSlots; ++slot) {
+		if (auto* snapshot = presetBank.get(slot)) {
+			StateFormat::Program program;
+			program.slot = slot;
+			program.name = presetBank.getName(slot);
+			std::copy(std::begin(snapshot->values), std::end(snapshot->values), program.values);
+			program.seed = snapshot->seed;
+			state.programs.push_back(std::move(program));
+		}
+	}
+
+	StateFormat::write(state, destData);
 }
 
 void Humanizer::setStateInformation(const void * data, int sizeInBytes) {
+	if (!StateFormat::isBlob(data, sizeInBytes)) {
+		setXmlState(data, sizeInBytes);
+		return;
+	}
+
+	// Values an older blob doesn't have go back to their defaults
+	StateFormat::State state;
+	for (int i = 0; i < StateFormat::numParameters; ++i)
+		state.values[i] = stateParameters[i]->convertFrom0to1(stateParameters[i]->getDefaultValue());
+	state.seed = curveGen.seed;
+
+	if (StateFormat::read(data, sizeInBytes, state))
+		applyState(state);
+}
+
+void Humanizer::applyState(const StateFormat::State& state) {
+	// What replaceState ends up doing per parameter, without the tree;
+	// unchanged parameters don't notify the host
+	for (int i = 0; i < StateFormat::numParameters; ++i) {
+		auto* parameter = stateParameters[i];
+		const float value = parameter->convertTo0to1(state.values[i]);
+		if (! exactlyEqual(parameter->getValue(), value))
+			parameter->setValueNotifyingHost(value);
+	}
+
+	curveGen.seed = state.seed;
+
+	GrooveMap groove;
+	if (state.groove.getSize() > 0)
+		groove.readFrom(state.groove.getData(), state.groove.getSize());
+	// Replacing the map suspends processing, skip it when both are empty
+	if (!groove.isEmpty() || !grooveMap.isEmpty())
+		setGrooveMap(groove);
+
+	presetBank.clearAll();
+	for (const auto& program : state.programs) {
+		PresetBank::Snapshot snapshot;
+		std::copy(std::begin(program.values), std::end(program.values), snapshot.values);
+		snapshot.seed = program.seed;
+		presetBank.store(program.slot, snapshot, program.name);
+	}
+	// The parameters above are the session's, which may differ from the program's
+	presetBank.restoreSelection(state.program);
+}
+
+void Humanizer::storeProgram(int index, const String& name) {
+	PresetBank::Snapshot snapshot;
+	for (int i = 0; i < StateFormat::numParameters; ++i)
+		snapshot.values[i] = stateParameters[i]->convertFrom0to1(stateParameters[i]->getValue());
+	snapshot.seed = curveGen.seed;
+	presetBank.store(index, snapshot, name);
+}
+
+void Humanizer::applyProgram(const PresetBank::Snapshot& snapshot) {
+	// Host notifications and listeners may lock or post messages, so only the
+	// raw values change here and the timer tells the host afterwards
+	for (int i = 0; i < StateFormat::numParameters; ++i) {
+		auto* parameter = stateParameters[i];
+		stateValues[i]->store(parameter->convertFrom0to1(parameter->convertTo0to1(snapshot.values[i])));
+	}
+	curveGen.seed = snapshot.seed;
+	programApplied = true;
+
+	// Jump to the new trajectory and fade into it, instead of ramping the smoothers
+	parameters.forEach([] (auto& p) {
+		if (p.parameter)
+			p.smoothed.setCurrentAndTargetValue(p.parameter->load());
+	});
+	programFade.start(roundToInt(programFadeMs / 1000.0 * getSampleRate()));
+}
+
+void Humanizer::publishProgram() {
+	// A value set since the program change is newer and stays
+	for (int i = 0; i < StateFormat::numParameters; ++i) {
+		auto* parameter = stateParameters[i];
+		const float value = parameter->convertTo0to1(stateValues[i]->load());
+		if (! exactlyEqual(parameter->getValue(), value))
+			parameter->setValueNotifyingHost(value);
+	}
+
+	// The raw values were already set, so the APVTS listeners stay quiet
+	++programChanges;
+	latencyChanged = true;
+}
+
+void Humanizer::setXmlState(const void* data, int sizeInBytes) {
 	std::unique_ptr<juce::XmlElement> xml(getXmlFromBinary(data, sizeInBytes));
 
 	if (xml != nullptr) {
@@ -158,9 +679,15 @@ void Humanizer::setStateInformation(const void * data, int sizeInBytes) {
 
 		apvts.replaceState(tree);
 
+		// An int var, a float would round seeds above 2^24
 		if (tree.hasProperty("seed")) {
-			bezierGen.seed = static_cast<float>(tree.getProperty("seed"));
+			curveGen.seed = static_cast<int>(tree.getProperty("seed"));
 		}
+
+		GrooveMap groove;
+		if (auto* grooveData = tree.getProperty("groove").getBinaryData())
+			groove.readFrom(grooveData->getData(), grooveData->getSize());
+		setGrooveMap(groove);
 	}
 }
 
@@ -171,7 +698,7 @@ AudioProcessor * JUCE_CALLTYPE createPluginFilter() {
 }
 
 void Humanizer::releaseResources() {
-	parameters.forEach([this] (Parameter& parameter) {
+	parameters.forEach([this] (auto& parameter) {
 		parameter.smoothed.reset(getSampleRate(), PluginConfig::ramptime);
 	});
 }
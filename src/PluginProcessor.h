@@ -1,35 +1,94 @@
 // PluginProcessor.h
 #pragma once
 #include <JuceHeader.h>
+#include <atomic>
 #include <limits>
 #include <algorithm>
 #include <cmath>
+#include <vector>
 #include "Types.h"
 #include "PluginConfig.h"
+#include "DelayKernel.h"
+#include "MidiScheduler.h"
+#include "Telemetry.h"
+#include "ParameterEvents.h"
+#include "BeatClock.h"
+#include "OversampledDelay.h"
+#include "ModulationSources.h"
+#include "GrooveMap.h"
+#include "StateFormat.h"
+#include "PresetBank.h"
+#include "DelayCrossfade.h"
+#include "Profiler.h"
 
-inline float hashToFloat(int seed, int index, int subSeed) {
-	unsigned int x = static_cast<unsigned int>(seed + index + subSeed);
+// Set by the HumanizerMidi target: moves MIDI notes instead of delaying audio
+#ifndef HUMANIZER_MIDI_EFFECT
+ #define HUMANIZER_MIDI_EFFECT 0
+#endif
 
-	x = ((x >> 16) ^ x) * 0x45d9f3b;
-	x = ((x >> 16) ^ x) * 0x45d9f3b;
-	x = (x >> 16) ^ x;
+class Humanizer;
 
-	return (static_cast<float>(x) / static_cast<float>(std::numeric_limits<unsigned int>::max()) * 2.0f) - 1.0f;
-}
+// The normalized curve, in [-1, 1], of the selected modulation source.
+// Segments are cached per seed and source, and every block loop is
+// instantiated for each source, so no source is called through a pointer.
+class CurveGenerator {
+	using Type = ModulationSources::Type;
+	static constexpr int numCoefficients = ModulationSources::numCoefficients;
 
-class Humanizer;
+	// Coefficients only depend on seed, source and segment index, not on speed.
+	struct Segment {
+		int index = std::numeric_limits<int>::min();
+		int seed = 0;
+		Type type = Type::bezier;
+		float c[numCoefficients] {};
+	};
+
+public:
+	// Channel curves evaluated together; lane l is stored at [sample * getLaneStride() + l]
+	static constexpr int maxLanes = 64;
+
+	static int getLaneStride(int numLanes) {
+		constexpr int simdWidth = Interpolators::simdWidth;
+		return (numLanes + simdWidth - 1) / simdWidth * simdWidth;
+	}
 
-class BezierGenerator {
-	struct Anchor {
-		float value;
-		float tension;
+private:
+	// Segment with one set of coefficients per lane, stored lane-contiguous
+	struct LaneSegment {
+		int index = std::numeric_limits<int>::min();
+		int seed = 0;
+		Type type = Type::bezier;
+		int numLanes = 0;
+		alignas(64) float c[numCoefficients][maxLanes] {};
 	};
 
 	Humanizer& humanizer;
+	Segment current;
+	Segment next;
+	LaneSegment currentLanes;
+	LaneSegment nextLanes;
+
+	template <typename Source>
+	void computeSegment(Segment& segment, int segmentIndex) const;
+	template <typename Source>
+	const Segment& getSegment(int segmentIndex);
+	template <typename Source>
+	void computeLaneSegment(LaneSegment& segment, int segmentIndex, int numLanes) const;
+	template <typename Source>
+	const LaneSegment& getLaneSegment(int segmentIndex, int numLanes);
+
+	// Splits [0, numSamples) into runs that stay inside one segment and calls
+	// fn(segmentIndex, t, dt, offset, length) for each of them
+	template <typename Fn>
+	void forEachRun(double startBeat, double beatIncrement, int numSamples, Fn&& fn);
+
+	Type getType() const;
+
 public:
-	int seed;
+	// Written on the message thread and by program changes on the audio thread
+	std::atomic<int> seed;
 
-	BezierGenerator(Humanizer& h, int seed) : humanizer(h) {
+	CurveGenerator(Humanizer& h, int seed) : humanizer(h) {
 		this->seed = seed;
 	}
 
@@ -40,11 +99,90 @@ public:
 
 	float getNormalized(double currentBeat);
 	double getValue(double currentBeat);
+
+	// Fills out[0..numSamples) with the normalized curve starting at startBeat.
+	// Speed and the source are read once per call; the loop only re-fetches
+	// coefficients when it crosses into the next segment.
+	void generateBlock(double startBeat, double beatIncrement, float* out, int numSamples);
+	// Same as generateBlock, but mapped to ms like getValue.
+	void getValues(double startBeat, double beatIncrement, float* out, int numSamples);
+	// One normalized curve per lane, interleaved with getLaneStride(numLanes).
+	// Lane 0 is the curve generateBlock produces.
+	void generateLanes(double startBeat, double beatIncrement, float* out, int numLanes, int numSamples);
 };
 
-class Humanizer : public AudioProcessor {
+class Humanizer : public AudioProcessor, private APVTS::Listener, private Timer {
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Humanizer);
-	dsp::DelayLine<float, dsp::DelayLineInterpolationTypes::Linear> delayLine;
+	DelayKernel delayKernel;
+	// Used instead of delayKernel while rendering offline. The tier is chosen
+	// when the delay line is prepared, not per block.
+	OversampledDelay oversampledDelay;
+	std::atomic<bool> offlineTier { false };
+	// Whether it was wanted, so a tier that failed to prepare isn't retried on every update
+	bool offlineTierWanted = false;
+	// Budget the delay line was sized for, and the latency reported to the host
+	std::atomic<float> preparedBudgetMs { 0.0f };
+	std::atomic<float> reportedLatencyMs { 0.0f };
+	// Lookahead of the interpolator the latency was reported for
+	std::atomic<int> reportedLookahead { 0 };
+	int preparedBlockSize = 0;
+	// MIDI effect: events moved into later blocks, and the clock their times refer to
+	MidiScheduler midiScheduler;
+	MidiBuffer midiOutput;
+	int64 midiClock = 0;
+	// Changes at sample offsets inside the next block
+	static constexpr int maxParameterEvents = 1024;
+	// Longest chunk while Speed ramps, the curve only reads Speed at chunk starts
+	static constexpr int speedRampChunk = 32;
+	ParameterEvents parameterEvents;
+	// Smoothed parameters changed through the APVTS since the last block, and the
+	// ticks they changed at; changes made on the audio thread are stamped noTicks
+	static constexpr int64 noTicks = std::numeric_limits<int64>::min();
+	std::atomic<uint32> changedParameters { 0 };
+	std::atomic<int64> changeTicks[PluginConfig::Registry::size] {};
+	std::atomic<Thread::ThreadID> audioThread { nullptr };
+	int64 lastBlockTicks = 0;
+	// Beat of every sample in the current block
+	BeatClock beatClock;
+	std::atomic<double> lastBpm { 120.0 };
+	GrooveMap grooveMap;
+	// Parameters in StateFormat order, looked up once, and their raw values
+	RangedAudioParameter* stateParameters[StateFormat::numParameters] {};
+	std::atomic<float>* stateValues[StateFormat::numParameters] {};
+	// Program changes are applied at the start of a block and crossfaded
+	static constexpr float programFadeMs = 5.0f;
+	PresetBank presetBank;
+	DelayCrossfade programFade;
+	// Set by the audio thread, the timer passes them on from the message thread
+	std::atomic<bool> latencyChanged { false };
+	std::atomic<bool> programApplied { false };
+	int programChanges = 0;
+	static constexpr int updateRateHz = 30;
+	std::vector<float> curveBlock;
+	std::vector<float> delayBlock;
+	// Per-channel path, used while Spread is above 0
+	std::vector<float> laneBlock;
+	std::vector<float> channelDelayBlock;
+	std::vector<const float*> channelDelays;
+
+	void computeDelays(float* delays, const float* curve, int numSamples, float requiredLatencyMs);
+	void processMidi(MidiBuffer& midiMessages, int numSamples, float requiredLatencyMs);
+	void prepareDelayLine(double sampleRate, int samplesPerBlock);
+	// Offline renders outside Late Only, whose zero latency has no room for the filters
+	bool wantsOfflineTier() const;
+	void reportLatency(double sampleRate);
+	// Turns the changes parameterChanged recorded into events of this block
+	void queueParameterChanges(int numSamples);
+	void applyState(const StateFormat::State& state);
+	// Audio thread: sets the raw values, smoothers and seed of a program change
+	void applyProgram(const PresetBank::Snapshot& snapshot);
+	// Message thread: tells the host about the values applyProgram set
+	void publishProgram();
+	// Sessions saved as XML, before the binary state
+	void setXmlState(const void* data, int sizeInBytes);
+	void updateLatency();
+	void parameterChanged(const String& parameterID, float newValue) override;
+	void timerCallback() override;
 
 public:
 	Humanizer();
@@ -53,80 +191,249 @@ public:
 	AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
 	void prepareToPlay(double sampleRate, int samplesPerBlock) override;
 	void releaseResources() override;
+	// The tier follows on the message thread, or at the next prepareToPlay
+	void setNonRealtime(bool isNonRealtime) noexcept override;
 	double getRequiredLatencyMs() const;
+	float getLatencyBudgetMs() const;
+	bool isLateOnly() const;
+	// Modulation source of the curve, read once per block
+	ModulationSources::Type getShape() const;
+	Interpolators::Type getInterpolation() const;
+	// Played by the Groove shape. Set on the message thread, processing is
+	// suspended while the map is replaced.
+	const GrooveMap& getGrooveMap() const { return grooveMap; }
+	void setGrooveMap(const GrooveMap& map);
+	// Tempo of the last processed block, for analysing a reference at the host tempo
+	double getLastBpm() const { return lastBpm.load(); }
+	// Range clamped to the budget, and Center as Late Only applies it
+	float getEffectiveRange(float range) const;
+	float getEffectiveCenter(float center) const;
 	bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
 	void processBlock(AudioBuffer<float>&, MidiBuffer&) override;
+	// Applies a change to a smoothed parameter at sampleOffset of the next processBlock,
+	// which splits its block there. Call it on the thread that calls processBlock; the
+	// parameter itself should also end up at the last value, as a host's would.
+	// Offsets past the block land on its last sample. Changes made through the
+	// APVTS become events too, see queueParameterChanges.
+	bool addParameterEvent(const ParameterSettings& settings, int sampleOffset, float value);
 	using AudioProcessor::processBlock;
 
 	AudioProcessorEditor* createEditor() override;
 	bool hasEditor() const override;
 	const String getName() const override { return JucePlugin_Name; };
-	bool acceptsMidi() const override { return false; };
-	bool producesMidi() const override { return false; };
-	bool isMidiEffect() const override { return false; };
+	bool acceptsMidi() const override { return HUMANIZER_MIDI_EFFECT; };
+	bool producesMidi() const override { return HUMANIZER_MIDI_EFFECT; };
+	bool isMidiEffect() const override { return HUMANIZER_MIDI_EFFECT; };
 	double getTailLengthSeconds() const override { return 0.0; };
 
-	int getNumPrograms() override { return 1; };
-	int getCurrentProgram() override { return 1; };
-	void setCurrentProgram(int index) override { ignoreUnused(index); };
-	const String getProgramName(int index) override { ignoreUnused (index); return {}; };
-	void changeProgramName(int index, const String& newName) override { ignoreUnused(index, newName); };
+	// Hosts may switch programs from the audio thread, the bank only records the index
+	int getNumPrograms() override { return PresetBank::numSlots; };
+	int getCurrentProgram() override { return presetBank.getSelected(); };
+	void setCurrentProgram(int index) override { presetBank.select(index); };
+	const String getProgramName(int index) override { return presetBank.getName(index); };
+	void changeProgramName(int index, const String& newName) override { presetBank.setName(index, newName); };
+	// Message thread: stores the current parameters and seed in a program slot
+	void storeProgram(int index, const String& name);
+	bool isProgramStored(int index) const { return presetBank.get(index) != nullptr; }
+	// Message thread: counts the program changes passed on to the host. Those set
+	// the parameters without calling the APVTS listeners, so editors poll this.
+	int getProgramChangeCount() const { return programChanges; }
 
 	void getStateInformation(MemoryBlock& destData) override;
 	void setStateInformation(const void* data, int sizeInBytes) override;
 
 	Parameters parameters;
 	APVTS apvts;
-	BezierGenerator bezierGen;
+	std::atomic<float>* interpolation = nullptr;
+	std::atomic<float>* shape = nullptr;
+	std::atomic<float>* maxRange = nullptr;
+	std::atomic<float>* lateOnly = nullptr;
+	CurveGenerator curveGen;
+	// Written by processBlock, read by the editor
+	Telemetry telemetry;
+	// Cost of every processBlock, in HUMANIZER_PROFILING builds
+	Profiler profiler;
 };
 
 //==============================================================================
 
-inline float BezierGenerator::getNormalized(double currentBeat) {
-	float speedBeats = humanizer.parameters.speed.smoothed.getCurrentValue();
+inline ModulationSources::Type CurveGenerator::getType() const {
+	return humanizer.getShape();
+}
+
+template <typename Source>
+inline void CurveGenerator::computeSegment(Segment& segment, int segmentIndex) const {
+	// Loaded once, so the cached seed is the one the coefficients came from
+	const int segmentSeed = seed;
+	Source::coefficients(segmentSeed, segmentIndex, 0, segment.c, 1);
+
+	segment.index = segmentIndex;
+	segment.seed = segmentSeed;
+	segment.type = Source::type;
+}
+
+template <typename Source>
+inline void CurveGenerator::computeLaneSegment(LaneSegment& segment, int segmentIndex, int numLanes) const {
+	const int segmentSeed = seed;
+	for (int lane = 0; lane < numLanes; ++lane)
+		Source::coefficients(segmentSeed, segmentIndex, lane, &segment.c[0][lane], maxLanes);
+
+	segment.index = segmentIndex;
+	segment.seed = segmentSeed;
+	segment.type = Source::type;
+	segment.numLanes = numLanes;
+}
+
+template <typename Source>
+inline const CurveGenerator::LaneSegment& CurveGenerator::getLaneSegment(int segmentIndex, int numLanes) {
+	auto matches = [this, numLanes] (const LaneSegment& s, int index) {
+		return s.index == index && s.seed == seed && s.type == Source::type && s.numLanes == numLanes;
+	};
+
+	if (matches(currentLanes, segmentIndex))
+		return currentLanes;
+
+	if (matches(nextLanes, segmentIndex)) {
+		currentLanes = nextLanes;
+	}
+	else {
+		computeLaneSegment<Source>(currentLanes, segmentIndex, numLanes);
+	}
+
+	computeLaneSegment<Source>(nextLanes, segmentIndex + 1, numLanes);
+	return currentLanes;
+}
+
+template <typename Source>
+inline const CurveGenerator::Segment& CurveGenerator::getSegment(int segmentIndex) {
+	auto matches = [this] (const Segment& s, int index) {
+		return s.index == index && s.seed == seed && s.type == Source::type;
+	};
+
+	if (matches(current, segmentIndex))
+		return current;
+
+	if (matches(next, segmentIndex)) {
+		current = next;
+	}
+	else {
+		computeSegment<Source>(current, segmentIndex);
+	}
+
+	computeSegment<Source>(next, segmentIndex + 1);
+	return current;
+}
+
+inline float CurveGenerator::getNormalized(double currentBeat) {
+	if (getType() == Type::groove)
+		return humanizer.getGrooveMap().getValue(currentBeat);
+
+	float speedBeats = humanizer.parameters.get<PluginConfig::speed>().smoothed.getCurrentValue();
 	speedBeats = std::max(0.1f, speedBeats);
 
 	double segmentFloat = currentBeat / speedBeats;
 	int segmentIndex = static_cast<int>(std::floor(segmentFloat));
 	float t = static_cast<float>(segmentFloat - segmentIndex);
 
-	// 1. Get Values and Tensions
-	float y0 = getDeterministicValue(segmentIndex, 0);
-	float y3 = getDeterministicValue(segmentIndex + 1, 0);
+	float value = 0.0f;
+	ModulationSources::withSource(getType(), [&] (auto source) {
+		using Source = decltype(source);
+		value = Source::template evaluate<1>(getSegment<Source>(segmentIndex).c, t);
+	});
+	return value;
+}
+
+inline double CurveGenerator::getValue(double currentBeat) {
+	float range = humanizer.getEffectiveRange(humanizer.parameters.get<PluginConfig::range>().smoothed.getCurrentValue());
+	float center = humanizer.getEffectiveCenter(humanizer.parameters.get<PluginConfig::center>().smoothed.getCurrentValue());
+
+	double noise = getNormalized(currentBeat);
+	return range * 0.5 * (center + noise);
+}
+
+template <typename Fn>
+inline void CurveGenerator::forEachRun(double startBeat, double beatIncrement, int numSamples, Fn&& fn) {
+	float speedBeats = humanizer.parameters.get<PluginConfig::speed>().smoothed.getCurrentValue();
+	speedBeats = std::max(0.1f, speedBeats);
 
-	// 1. Get raw random values [0.0, 1.0]
-	float rawHashOut = std::abs(getDeterministicValue(segmentIndex, 100));
-	float rawHashIn  = std::abs(getDeterministicValue(segmentIndex + 1, 100));
+	const double segmentIncrement = beatIncrement / speedBeats;
+	int i = 0;
 
-	// 2. Define your range
-	constexpr float minTension = 0.1f;
-	constexpr float maxTension = 0.45f;
+	while (i < numSamples) {
+		// Recompute the position from the start of the block so long blocks don't drift
+		double segmentFloat = (startBeat + beatIncrement * i) / speedBeats;
+		int segmentIndex = static_cast<int>(std::floor(segmentFloat));
+		double t0 = segmentFloat - segmentIndex;
 
-	// 3. Map the [0.0, 1.0] range to [0.1, 0.45]
-	float tensionOut = jmap(rawHashOut, 0.0f, 1.0f, minTension, maxTension);
-	float tensionIn  = jmap(rawHashIn,  0.0f, 1.0f, minTension, maxTension);
+		int run = numSamples - i;
+		if (segmentIncrement > 0.0) {
+			double untilNext = std::ceil((1.0 - t0) / segmentIncrement);
+			run = static_cast<int>(jlimit(1.0, static_cast<double>(run), untilNext));
+		}
 
-	// 2. Adjust the weights based on tension
-	float invT = 1.0f - t;
+		fn(segmentIndex, static_cast<float>(t0), static_cast<float>(segmentIncrement), i, run);
+		i += run;
+	}
+}
 
-	float w1 = 3.0f * (1.0f + tensionOut * 5.0f);
-	float w2 = 3.0f * (1.0f + tensionIn * 5.0f);
+inline void CurveGenerator::generateBlock(double startBeat, double beatIncrement, float* out, int numSamples) {
+	if (getType() == Type::groove) {
+		humanizer.getGrooveMap().fill(startBeat, beatIncrement, out, numSamples);
+		return;
+	}
 
-	// 3. Calculate weighted Bezier
-	float term0 = invT * invT * invT;
-	float term1 = w1 * invT * invT * t;
-	float term2 = w2 * t * t * invT;
-	float term3 = t * t * t;
+	ModulationSources::withSource(getType(), [&] (auto source) {
+		using Source = decltype(source);
 
-	float totalWeight = term0 + term1 + term2 + term3;
+		forEachRun(startBeat, beatIncrement, numSamples, [this, out] (int segmentIndex, float t, float dt, int offset, int run) {
+			const Segment s = getSegment<Source>(segmentIndex);
+			float* dest = out + offset;
 
-	return (term0 * y0 + term1 * y0 + term2 * y3 + term3 * y3) / totalWeight;
+			// No loop-carried state, so this vectorizes
+			for (int k = 0; k < run; ++k)
+				dest[k] = Source::template evaluate<1>(s.c, t + dt * static_cast<float>(k));
+		});
+	});
 }
 
-inline double BezierGenerator::getValue(double currentBeat) {
-	float range = humanizer.parameters.range.smoothed.getCurrentValue();
-	float center = humanizer.parameters.center.smoothed.getCurrentValue();
+inline void CurveGenerator::generateLanes(double startBeat, double beatIncrement, float* out, int numLanes, int numSamples) {
+	numLanes = jlimit(1, maxLanes, numLanes);
+	const int stride = getLaneStride(numLanes);
 
-	double noise = getNormalized(currentBeat);
-	return range * 0.5 * (center + noise);
+	// One groove for every channel: fill lane 0 and copy it across
+	if (getType() == Type::groove) {
+		humanizer.getGrooveMap().fill(startBeat, beatIncrement, out, numSamples, stride);
+		for (int k = 0; k < numSamples; ++k) {
+			float* frame = out + k * stride;
+			for (int lane = 1; lane < numLanes; ++lane)
+				frame[lane] = frame[0];
+		}
+		return;
+	}
+
+	ModulationSources::withSource(getType(), [&] (auto source) {
+		using Source = decltype(source);
+
+		forEachRun(startBeat, beatIncrement, numSamples, [this, out, numLanes, stride] (int segmentIndex, float t0, float dt, int offset, int run) {
+			const LaneSegment& s = getLaneSegment<Source>(segmentIndex, numLanes);
+
+			for (int k = 0; k < run; ++k) {
+				const float t = t0 + dt * static_cast<float>(k);
+				float* frame = out + (offset + k) * stride;
+
+				// Lane-contiguous coefficients: one channel per SIMD lane
+				for (int lane = 0; lane < numLanes; ++lane)
+					frame[lane] = Source::template evaluate<maxLanes>(&s.c[0][lane], t);
+			}
+		});
+	});
+}
+
+inline void CurveGenerator::getValues(double startBeat, double beatIncrement, float* out, int numSamples) {
+	float range = humanizer.getEffectiveRange(humanizer.parameters.get<PluginConfig::range>().smoothed.getCurrentValue());
+	float center = humanizer.getEffectiveCenter(humanizer.parameters.get<PluginConfig::center>().smoothed.getCurrentValue());
+
+	generateBlock(startBeat, beatIncrement, out, numSamples);
+	FloatVectorOperations::add(out, center, numSamples);
+	FloatVectorOperations::multiply(out, range * 0.5f, numSamples);
 }
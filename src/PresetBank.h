@@ -0,0 +1,139 @@
+// PresetBank.h
+#pragma once
+#include <JuceHeader.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "StateFormat.h"
+
+// Programs the host switches between, e.g. one feel per song section.
+// A slot holds every parameter in StateFormat order and the seed.
+//
+// Slots are written on the message thread, which publishes each one as an
+// immutable Snapshot through an atomic pointer. The audio thread loads the
+// pointer of the selected slot and copies the snapshot out, so switching
+// never locks or allocates there. It announces the snapshot it is reading,
+// and a replaced snapshot is only freed once nobody is.
+class PresetBank {
+public:
+	static constexpr int numSlots = 128;
+
+	struct Snapshot {
+		float values[StateFormat::numParameters] {};
+		int seed = 0;
+	};
+
+	PresetBank() {
+		for (auto& slot : slots)
+			slot.store(nullptr);
+	}
+
+	~PresetBank() {
+		for (auto& slot : slots)
+			delete slot.exchange(nullptr);
+		for (auto* snapshot : retired)
+			delete snapshot;
+	}
+
+	// Message thread ---------------------------------------------------------
+
+	void store(int slot, const Snapshot& snapshot, const String& name) {
+		if (!isPositiveAndBelow(slot, numSlots))
+			return;
+		names[slot] = name;
+		retire(slots[slot].exchange(new Snapshot(snapshot)));
+	}
+
+	void clear(int slot) {
+		if (!isPositiveAndBelow(slot, numSlots))
+			return;
+		names[slot] = {};
+		retire(slots[slot].exchange(nullptr));
+	}
+
+	void clearAll() {
+		for (int slot = 0; slot < numSlots; ++slot)
+			clear(slot);
+	}
+
+	// Only the message thread replaces snapshots, so this one stays valid there
+	const Snapshot* get(int slot) const {
+		return isPositiveAndBelow(slot, numSlots) ? slots[slot].load() : nullptr;
+	}
+
+	String getName(int slot) const {
+		if (!isPositiveAndBelow(slot, numSlots))
+			return {};
+		return names[slot].isNotEmpty() ? names[slot] : "Program " + String(slot + 1);
+	}
+
+	void setName(int slot, const String& name) {
+		if (isPositiveAndBelow(slot, numSlots))
+			names[slot] = name;
+	}
+
+	// Any thread -------------------------------------------------------------
+
+	void select(int slot) { selected = jlimit(0, numSlots - 1, slot); }
+	int getSelected() const { return selected.load(); }
+
+	// Selects slot as already applied, for a state recall that set the
+	// parameters itself
+	void restoreSelection(int slot) {
+		slot = jlimit(0, numSlots - 1, slot);
+		pulled = slot;
+		selected = slot;
+	}
+
+	// Audio thread -----------------------------------------------------------
+
+	// Copies the selected slot into dest once per selection. Empty slots are
+	// taken as selected but leave the sound as it is.
+	bool pull(Snapshot& dest) {
+		const int slot = selected.load();
+		if (slot == pulled.load())
+			return false;
+
+		const Snapshot* snapshot = slots[slot].load();
+		if (snapshot == nullptr) {
+			pulled = slot;
+			return false;
+		}
+
+		// If the slot still holds it after it was announced, it won't be freed
+		reading.store(snapshot);
+		if (slots[slot].load() != snapshot) {
+			reading.store(nullptr);
+			return false; // replaced meanwhile, the next block gets the new one
+		}
+
+		dest = *snapshot;
+		reading.store(nullptr);
+		pulled = slot;
+		return true;
+	}
+
+private:
+	std::atomic<const Snapshot*> slots[numSlots];
+	String names[numSlots];
+	std::atomic<int> selected { 0 };
+	std::atomic<const Snapshot*> reading { nullptr };
+	// Slot of the last pull
+	std::atomic<int> pulled { 0 };
+	// Replaced snapshots the audio thread may still be copying
+	std::vector<const Snapshot*> retired;
+
+	void retire(const Snapshot* snapshot) {
+		if (snapshot != nullptr)
+			retired.push_back(snapshot);
+
+		const Snapshot* inUse = reading.load();
+		retired.erase(std::remove_if(retired.begin(), retired.end(), [inUse] (const Snapshot* s) {
+			if (s == inUse)
+				return false;
+			delete s;
+			return true;
+		}), retired.end());
+	}
+};
@@ -0,0 +1,141 @@
+// Profiler.h
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+
+// Counts what processBlock costs, for the editor overlay and the tools.
+// Built with HUMANIZER_PROFILING=0 every member is an empty inline function
+// and Scope is an empty struct, so nothing is left in the audio path.
+#ifndef HUMANIZER_PROFILING
+ #define HUMANIZER_PROFILING 0
+#endif
+
+// Per-block wall time, its running maximum, a histogram of the load and the
+// deadline misses. The load is the block's time over its real-time deadline,
+// numSamples / sampleRate; a block over 100 % is a miss. Everything is a
+// relaxed atomic written by the audio thread only, so recording is a few
+// loads and stores and readers on any thread see consistent enough values.
+class Profiler {
+public:
+	static constexpr bool enabled = HUMANIZER_PROFILING != 0;
+	// Buckets of 12.5 % load; the last one also takes everything above 200 %
+	static constexpr int numBuckets = 16;
+	static constexpr double bucketLoad = 0.125;
+
+	struct Counters {
+		uint64 blocks = 0;
+		uint64 samples = 0;
+		uint64 deadlineMisses = 0;
+		uint64 totalNs = 0;
+		uint64 lastNs = 0;
+		uint64 maxNs = 0;
+		// Load of the most expensive block, which need not be the longest one
+		double maxLoad = 0.0;
+		uint64 histogram[numBuckets] {};
+
+		double meanNs() const { return blocks > 0 ? static_cast<double>(totalNs) / static_cast<double>(blocks) : 0.0; }
+	};
+
+	// Times the enclosing block, including early returns
+	struct Scope {
+	   #if HUMANIZER_PROFILING
+		Scope(Profiler& p, int numSamples, double sampleRate)
+			: profiler(p), samples(numSamples), rate(sampleRate), start(Time::getHighResolutionTicks()) {}
+		~Scope() { profiler.record(Time::getHighResolutionTicks() - start, samples, rate); }
+
+		Profiler& profiler;
+		const int samples;
+		const double rate;
+		const int64 start;
+	   #else
+		Scope(Profiler&, int, double) {}
+	   #endif
+	};
+
+   #if HUMANIZER_PROFILING
+	// Audio thread
+	void record(int64 ticks, int numSamples, double sampleRate) {
+		static const double nsPerTick = 1.0e9 / static_cast<double>(Time::getHighResolutionTicksPerSecond());
+		const auto ns = static_cast<uint64>(static_cast<double>(ticks) * nsPerTick);
+		const double deadlineNs = sampleRate > 0.0 ? numSamples * 1.0e9 / sampleRate : 0.0;
+		const double load = deadlineNs > 0.0 ? static_cast<double>(ns) / deadlineNs : 0.0;
+
+		increment(blocks, 1);
+		increment(samples, static_cast<uint64>(numSamples));
+		increment(totalNs, ns);
+		lastNs.store(ns, std::memory_order_relaxed);
+		if (ns > maxNs.load(std::memory_order_relaxed))
+			maxNs.store(ns, std::memory_order_relaxed);
+		if (load > maxLoad.load(std::memory_order_relaxed))
+			maxLoad.store(load, std::memory_order_relaxed);
+		if (load > 1.0)
+			increment(deadlineMisses, 1);
+		increment(histogram[jmin(numBuckets - 1, static_cast<int>(load / bucketLoad))], 1);
+	}
+
+	// Any thread. A block recorded meanwhile may be half counted.
+	void reset() {
+		for (auto* counter : { &blocks, &samples, &deadlineMisses, &totalNs, &lastNs, &maxNs })
+			counter->store(0, std::memory_order_relaxed);
+		maxLoad.store(0.0, std::memory_order_relaxed);
+		for (auto& bucket : histogram)
+			bucket.store(0, std::memory_order_relaxed);
+	}
+
+	Counters read() const {
+		Counters c;
+		c.blocks = blocks.load(std::memory_order_relaxed);
+		c.samples = samples.load(std::memory_order_relaxed);
+		c.deadlineMisses = deadlineMisses.load(std::memory_order_relaxed);
+		c.totalNs = totalNs.load(std::memory_order_relaxed);
+		c.lastNs = lastNs.load(std::memory_order_relaxed);
+		c.maxNs = maxNs.load(std::memory_order_relaxed);
+		c.maxLoad = maxLoad.load(std::memory_order_relaxed);
+		for (int i = 0; i < numBuckets; ++i)
+			c.histogram[i] = histogram[i].load(std::memory_order_relaxed);
+		return c;
+	}
+   #else
+	void record(int64, int, double) {}
+	void reset() {}
+	Counters read() const { return {}; }
+   #endif
+
+	// For the tools: the counters as a JSON object
+	var toJson() const {
+		const auto c = read();
+		auto* result = new DynamicObject();
+		result->setProperty("enabled", enabled);
+		result->setProperty("blocks", static_cast<int64>(c.blocks));
+		result->setProperty("samples", static_cast<int64>(c.samples));
+		result->setProperty("deadlineMisses", static_cast<int64>(c.deadlineMisses));
+		result->setProperty("meanNs", c.meanNs());
+		result->setProperty("lastNs", static_cast<int64>(c.lastNs));
+		result->setProperty("maxNs", static_cast<int64>(c.maxNs));
+		result->setProperty("maxLoad", c.maxLoad);
+		result->setProperty("bucketLoad", bucketLoad);
+
+		Array<var> buckets;
+		for (auto count : c.histogram)
+			buckets.add(static_cast<int64>(count));
+		result->setProperty("histogram", buckets);
+		return var(result);
+	}
+
+private:
+   #if HUMANIZER_PROFILING
+	// Single writer, so a load and a store instead of a locked add
+	static void increment(std::atomic<uint64>& counter, uint64 amount) {
+		counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+	}
+
+	std::atomic<uint64> blocks { 0 };
+	std::atomic<uint64> samples { 0 };
+	std::atomic<uint64> deadlineMisses { 0 };
+	std::atomic<uint64> totalNs { 0 };
+	std::atomic<uint64> lastNs { 0 };
+	std::atomic<uint64> maxNs { 0 };
+	std::atomic<double> maxLoad { 0.0 };
+	std::atomic<uint64> histogram[numBuckets] {};
+   #endif
+};
@@ -0,0 +1,67 @@
+// ProfilerOverlay.h
+#pragma once
+#include <JuceHeader.h>
+#include "Profiler.h"
+#include "UiResources.h"
+
+// Profiler counters drawn over the diagram: block times, deadline misses
+// and the load histogram. Only exists in HUMANIZER_PROFILING builds.
+class ProfilerOverlay : public Component {
+	SharedResourcePointer<UiResources> resources;
+	Profiler::Counters counters;
+	double lastRefreshMs = 0.0;
+
+	// A few refreshes per second are readable, every frame would only flicker
+	static constexpr double refreshMs = 250.0;
+
+	static String formatUs(double ns) {
+		return String(ns / 1000.0, 1) + " us";
+	}
+
+public:
+	ProfilerOverlay() {
+		setInterceptsMouseClicks(false, false);
+	}
+
+	// Called on every display refresh while visible
+	void update(const Profiler& profiler, double nowMs) {
+		if (nowMs - lastRefreshMs < refreshMs)
+			return;
+		lastRefreshMs = nowMs;
+		counters = profiler.read();
+		repaint();
+	}
+
+	void paint(Graphics& g) override {
+		auto bounds = getLocalBounds().toFloat();
+		g.setColour(Colours::black.withAlpha(0.75f));
+		g.fillRoundedRectangle(bounds, 4.0f);
+
+		auto text = bounds.reduced(8.0f);
+		g.setColour(Colours::white.withAlpha(0.9f));
+		g.setFont(resources->labelFont.withHeight(12.0f));
+
+		const String lines[] {
+			"blocks " + String(static_cast<int64>(counters.blocks)),
+			"last " + formatUs(static_cast<double>(counters.lastNs)) + ", mean " + formatUs(counters.meanNs()),
+			"max " + formatUs(static_cast<double>(counters.maxNs)) + ", load " + String(counters.maxLoad * 100.0, 1) + " %",
+			"deadline misses " + String(static_cast<int64>(counters.deadlineMisses)),
+		};
+		for (auto& line : lines)
+			g.drawText(line, text.removeFromTop(15.0f), Justification::centredLeft);
+
+		// Histogram of the load, 0 % on the left; misses are drawn in the accent colour
+		text.removeFromTop(4.0f);
+		uint64 highest = 1;
+		for (auto count : counters.histogram)
+			highest = jmax(highest, count);
+
+		const float barWidth = text.getWidth() / Profiler::numBuckets;
+		for (int i = 0; i < Profiler::numBuckets; ++i) {
+			const float height = text.getHeight() * static_cast<float>(counters.histogram[i]) / static_cast<float>(highest);
+			const bool misses = (i + 1) * Profiler::bucketLoad > 1.0;
+			g.setColour(misses ? ModernTheme::mainAccent.brighter(0.5f) : Colours::white.withAlpha(0.6f));
+			g.fillRect(text.getX() + i * barWidth, text.getBottom() - height, barWidth - 1.0f, height);
+		}
+	}
+};
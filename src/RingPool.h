@@ -0,0 +1,133 @@
+// RingPool.h
+#pragma once
+#include <JuceHeader.h>
+#include <cstdlib>
+#include <vector>
+
+// Page-aligned memory shared by every instance in the process.
+// A block given back by one instance is handed to the next one asking for a
+// similar size, so hosts re-preparing many instances don't go back to the
+// system allocator each time. At most maxSpares blocks are kept, older ones
+// go back to the system. Hold the pool through SharedResourcePointer; the
+// rest is returned with the last instance.
+class RingPool {
+public:
+	// Owns one block until it is destroyed or reset, then returns it to the pool
+	class Block {
+		RingPool* pool = nullptr;
+		void* data = nullptr;
+		size_t size = 0;
+
+		friend class RingPool;
+		Block(RingPool& owner, void* memory, size_t bytes) : pool(&owner), data(memory), size(bytes) {}
+
+	public:
+		Block() = default;
+		Block(Block&& other) noexcept { swap(other); }
+		Block& operator=(Block&& other) noexcept { Block(std::move(other)).swap(*this); return *this; }
+		~Block() { reset(); }
+
+		void reset() {
+			if (pool != nullptr)
+				pool->release(data, size);
+			pool = nullptr;
+			data = nullptr;
+			size = 0;
+		}
+
+		void swap(Block& other) noexcept {
+			std::swap(pool, other.pool);
+			std::swap(data, other.data);
+			std::swap(size, other.size);
+		}
+
+		template <typename T>
+		T* get() const { return static_cast<T*>(data); }
+		size_t getSize() const { return size; }
+
+		JUCE_DECLARE_NON_COPYABLE(Block)
+	};
+
+	static constexpr size_t maxSpares = 16;
+
+	RingPool() = default;
+
+	~RingPool() {
+		// Every Block must be gone by now, they point back to the pool
+		for (auto& spare : spares)
+			freePages(spare.data);
+	}
+
+	// Returns at least bytes of page-aligned memory, not cleared.
+	// The Block is empty if the system is out of memory.
+	Block acquire(size_t bytes) {
+		const size_t pageSize = static_cast<size_t>(jmax(4096, SystemStats::getPageSize()));
+		bytes = (jmax<size_t>(bytes, 1) + pageSize - 1) / pageSize * pageSize;
+
+		{
+			const ScopedLock sl(lock);
+
+			// Best fit, but never more than twice the request
+			int best = -1;
+			for (int i = 0; i < static_cast<int>(spares.size()); ++i) {
+				const size_t size = spares[static_cast<size_t>(i)].size;
+				if (size >= bytes && size <= bytes * 2 && (best < 0 || size < spares[static_cast<size_t>(best)].size))
+					best = i;
+			}
+
+			if (best >= 0) {
+				auto spare = spares[static_cast<size_t>(best)];
+				spares.erase(spares.begin() + best);
+				return Block(*this, spare.data, spare.size);
+			}
+		}
+
+		void* memory = allocatePages(bytes, pageSize);
+		if (memory == nullptr) {
+			jassertfalse;
+			return {};
+		}
+		return Block(*this, memory, bytes);
+	}
+
+private:
+	struct Spare {
+		void* data;
+		size_t size;
+	};
+
+	CriticalSection lock;
+	// Oldest first
+	std::vector<Spare> spares;
+
+	void release(void* data, size_t size) {
+		if (data == nullptr)
+			return;
+
+		const ScopedLock sl(lock);
+		if (spares.size() == maxSpares) {
+			freePages(spares.front().data);
+			spares.erase(spares.begin());
+		}
+		spares.push_back({ data, size });
+	}
+
+	static void* allocatePages(size_t bytes, size_t pageSize) {
+	   #if JUCE_WINDOWS
+		return _aligned_malloc(bytes, pageSize);
+	   #else
+		void* memory = nullptr;
+		return posix_memalign(&memory, pageSize, bytes) == 0 ? memory : nullptr;
+	   #endif
+	}
+
+	static void freePages(void* memory) {
+	   #if JUCE_WINDOWS
+		_aligned_free(memory);
+	   #else
+		std::free(memory);
+	   #endif
+	}
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(RingPool)
+};
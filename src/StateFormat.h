@@ -0,0 +1,153 @@
+// StateFormat.h
+#pragma once
+#include <JuceHeader.h>
+#include <algorithm>
+#include <iterator>
+#include <vector>
+#include "PluginConfig.h"
+
+// Binary plugin state, read and written without a ValueTree or XML.
+//
+// Layout, little-endian:
+//   uint32 magic, int32 version, int32 numValues,
+//   float values[numValues]        plain parameter values, in the order below
+//   int32 seed                     the full seed, not rounded through a float
+//   int32 grooveSize, grooveSize bytes of GrooveMap::writeTo
+// Version 2 appends the program bank:
+//   int32 program, int32 numPrograms, then per stored program
+//   int32 slot, int32 nameSize, nameSize bytes of UTF-8,
+//   float values[numValues], int32 seed
+//
+// Later versions only append fields, so an older reader still finds
+// everything it knows at the same offsets. Sessions saved before the blob
+// existed are XML, which setStateInformation still reads.
+namespace StateFormat {
+	static constexpr uint32 magic = 0x7a6d7548; // "Humz"
+	static constexpr int version = 2;
+
+	// Append only: a blob holds as many values as its writer knew
+	static const ParameterSettings* const parameters[] {
+		&PluginConfig::range,
+		&PluginConfig::center,
+		&PluginConfig::speed,
+		&PluginConfig::spread,
+		&PluginConfig::interpolation,
+		&PluginConfig::shape,
+		&PluginConfig::maxRange,
+		&PluginConfig::lateOnly,
+	};
+	static constexpr int numParameters = static_cast<int>(std::size(parameters));
+
+	struct Program {
+		int slot = 0;
+		String name;
+		float values[numParameters] {};
+		int seed = 0;
+	};
+
+	struct State {
+		float values[numParameters] {};
+		int seed = 0;
+		MemoryBlock groove;
+		int program = 0;
+		std::vector<Program> programs;
+	};
+
+	inline void writeValues(MemoryOutputStream& stream, const float* values) {
+		stream.writeInt(numParameters);
+		for (int i = 0; i < numParameters; ++i)
+			stream.writeFloat(values[i]);
+	}
+
+	// Values past numParameters are skipped, ones the blob lacks are left alone
+	inline bool readValues(MemoryInputStream& stream, float* values) {
+		const int numValues = stream.readInt();
+		if (numValues < 0 || stream.getNumBytesRemaining() < static_cast<int64>(numValues) * 4)
+			return false;
+
+		for (int i = 0; i < numValues; ++i) {
+			const float value = stream.readFloat();
+			if (i < numParameters)
+				values[i] = value;
+		}
+		return true;
+	}
+
+	inline void write(const State& state, MemoryBlock& dest) {
+		dest.reset();
+		MemoryOutputStream stream(dest, false);
+		stream.writeInt(static_cast<int>(magic));
+		stream.writeInt(version);
+		writeValues(stream, state.values);
+		stream.writeInt(state.seed);
+		stream.writeInt(static_cast<int>(state.groove.getSize()));
+		stream.write(state.groove.getData(), state.groove.getSize());
+
+		stream.writeInt(state.program);
+		stream.writeInt(static_cast<int>(state.programs.size()));
+		for (const auto& program : state.programs) {
+			stream.writeInt(program.slot);
+			const auto name = program.name.toUTF8();
+			const auto nameSize = static_cast<int>(name.sizeInBytes()) - 1;
+			stream.writeInt(nameSize);
+			stream.write(name.getAddress(), static_cast<size_t>(nameSize));
+			writeValues(stream, program.values);
+			stream.writeInt(program.seed);
+		}
+	}
+
+	inline bool isBlob(const void* data, int sizeInBytes) {
+		return sizeInBytes >= 8 && static_cast<uint32>(ByteOrder::littleEndianInt(data)) == magic;
+	}
+
+	// Values the blob doesn't have keep what state held before.
+	// Returns false if data isn't a blob or is cut short.
+	inline bool read(const void* data, int sizeInBytes, State& state) {
+		if (!isBlob(data, sizeInBytes))
+			return false;
+
+		MemoryInputStream stream(data, static_cast<size_t>(sizeInBytes), false);
+		stream.readInt();
+		const int blobVersion = stream.readInt();
+		if (blobVersion < 1)
+			return false;
+
+		if (!readValues(stream, state.values) || stream.getNumBytesRemaining() < 8)
+			return false;
+
+		state.seed = stream.readInt();
+		const int grooveSize = stream.readInt();
+		if (grooveSize < 0 || stream.getNumBytesRemaining() < grooveSize)
+			return false;
+
+		state.groove.setSize(static_cast<size_t>(grooveSize));
+		stream.read(state.groove.getData(), grooveSize);
+
+		if (blobVersion < 2 || stream.getNumBytesRemaining() < 8)
+			return true;
+
+		state.program = stream.readInt();
+		const int numPrograms = stream.readInt();
+		state.programs.clear();
+		for (int i = 0; i < numPrograms; ++i) {
+			Program program;
+			std::copy(std::begin(state.values), std::end(state.values), program.values);
+			if (stream.getNumBytesRemaining() < 8)
+				return false;
+
+			program.slot = stream.readInt();
+			const int nameSize = stream.readInt();
+			if (nameSize < 0 || stream.getNumBytesRemaining() < nameSize)
+				return false;
+			MemoryBlock name(static_cast<size_t>(nameSize));
+			stream.read(name.getData(), nameSize);
+			program.name = String::fromUTF8(static_cast<const char*>(name.getData()), nameSize);
+
+			if (!readValues(stream, program.values) || stream.getNumBytesRemaining() < 4)
+				return false;
+			program.seed = stream.readInt();
+			state.programs.push_back(std::move(program));
+		}
+		return true;
+	}
+}
@@ -0,0 +1,166 @@
+// Telemetry.h
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// One bucket of what the audio thread applied, with the transport at its end.
+// Shifts are in ms relative to the reported latency, like the diagram shows them.
+struct TelemetryFrame {
+	double ppq = 0.0;
+	double bpm = 120.0;
+	float minShiftMs = 0.0f;
+	float maxShiftMs = 0.0f;
+	bool isPlaying = false;
+};
+
+// Decimated audio -> editor feed. The audio thread is the only writer and the
+// message thread the only reader, so an AbstractFifo keeps both ends wait-free.
+// A bucket spans a fixed number of beats chosen by the editor, one pixel each.
+// Nothing is written while no editor is reading, and what the last editor
+// left unread is dropped when the next one attaches.
+class Telemetry {
+public:
+	static constexpr int capacity = 4096;
+
+	Telemetry() : fifo(capacity) {
+		frames.resize(static_cast<size_t>(capacity));
+	}
+
+	// Message thread
+	void setConsumer(bool isActive, double beatsPerBucket) {
+		bucketBeats = jmax(1.0e-6, beatsPerBucket);
+
+		// The read position is ours, so stale frames are skipped from this end
+		if (isActive && !active.load())
+			fifo.finishedRead(fifo.getNumReady());
+		active = isActive;
+	}
+
+	int read(TelemetryFrame* dest, int maxFrames) {
+		int start1, size1, start2, size2;
+		fifo.prepareToRead(maxFrames, start1, size1, start2, size2);
+
+		for (int i = 0; i < size1; ++i)
+			dest[i] = frames[static_cast<size_t>(start1 + i)];
+		for (int i = 0; i < size2; ++i)
+			dest[size1 + i] = frames[static_cast<size_t>(start2 + i)];
+
+		fifo.finishedRead(size1 + size2);
+		return size1 + size2;
+	}
+
+	// Audio thread
+	bool isActive() const { return active.load(std::memory_order_relaxed); }
+
+	// delays are in samples; shift = delay * msPerSample - latencyMs
+	void write(double startBeat, double beatIncrement, double bpm, bool isPlaying,
+			   const float* delays, float msPerSample, float latencyMs, int numSamples) {
+		if (!beginBlock(bpm, isPlaying) || numSamples <= 0)
+			return;
+
+		const double bucketLength = bucketBeats.load(std::memory_order_relaxed);
+		int i = 0;
+
+		while (i < numSamples) {
+			const double beat = startBeat + beatIncrement * i;
+			const int64 bucket = static_cast<int64>(std::floor(beat / bucketLength));
+
+			// Samples left in this bucket
+			int run = numSamples - i;
+			if (beatIncrement > 0.0) {
+				const double untilNext = std::ceil(((bucket + 1) * bucketLength - beat) / beatIncrement);
+				run = static_cast<int>(jlimit(1.0, static_cast<double>(run), untilNext));
+			}
+
+			const auto range = FloatVectorOperations::findMinAndMax(delays + i, run);
+			accumulate(bucket, bucketLength, range.getStart() * msPerSample - latencyMs, range.getEnd() * msPerSample - latencyMs);
+			i += run;
+		}
+	}
+
+	// For paths without per-sample delays: shiftAt(beat) is sampled once per bucket
+	template <typename ShiftAt>
+	void writeSampled(double startBeat, double beatIncrement, double bpm, bool isPlaying, int numSamples, ShiftAt&& shiftAt) {
+		if (!beginBlock(bpm, isPlaying) || numSamples <= 0)
+			return;
+
+		const double bucketLength = bucketBeats.load(std::memory_order_relaxed);
+		const double endBeat = startBeat + beatIncrement * numSamples;
+		const int64 firstBucket = static_cast<int64>(std::floor(startBeat / bucketLength));
+		const int64 lastBucket = jmax(firstBucket, static_cast<int64>(std::ceil(endBeat / bucketLength)) - 1);
+
+		for (int64 bucket = firstBucket; bucket <= lastBucket; ++bucket) {
+			const double beat = jmax(startBeat, static_cast<double>(bucket) * bucketLength);
+			const float shift = shiftAt(beat);
+			accumulate(bucket, bucketLength, shift, shift);
+		}
+	}
+
+private:
+	AbstractFifo fifo;
+	std::vector<TelemetryFrame> frames;
+	std::atomic<bool> active { false };
+	std::atomic<double> bucketBeats { 1.0 / 64.0 };
+
+	// Producer state
+	TelemetryFrame pending;
+	int64 pendingBucket = std::numeric_limits<int64>::min();
+	bool wasPlaying = false;
+
+	void push(const TelemetryFrame& frame) {
+		int start1, size1, start2, size2;
+		fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+		// Full means the editor isn't keeping up, drop rather than wait
+		if (size1 > 0)
+			frames[static_cast<size_t>(start1)] = frame;
+		fifo.finishedWrite(size1);
+	}
+
+	// Returns false when there is nothing to accumulate this block
+	bool beginBlock(double bpm, bool isPlaying) {
+		// Start over when an editor attaches, not from the last one's bucket
+		if (!isActive()) {
+			pendingBucket = std::numeric_limits<int64>::min();
+			wasPlaying = false;
+			return false;
+		}
+
+		pending.bpm = bpm;
+		if (isPlaying) {
+			wasPlaying = true;
+			return true;
+		}
+
+		// One frame tells the editor the transport stopped
+		if (wasPlaying) {
+			pending.isPlaying = false;
+			push(pending);
+			pendingBucket = std::numeric_limits<int64>::min();
+			wasPlaying = false;
+		}
+		return false;
+	}
+
+	void accumulate(int64 bucket, double bucketLength, float minShift, float maxShift) {
+		if (bucket != pendingBucket) {
+			if (pendingBucket != std::numeric_limits<int64>::min())
+				push(pending);
+
+			pendingBucket = bucket;
+			pending.ppq = static_cast<double>(bucket + 1) * bucketLength;
+			pending.isPlaying = true;
+			pending.minShiftMs = minShift;
+			pending.maxShiftMs = maxShift;
+			return;
+		}
+
+		pending.minShiftMs = jmin(pending.minShiftMs, minShift);
+		pending.maxShiftMs = jmax(pending.maxShiftMs, maxShift);
+	}
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Telemetry)
+};
@@ -0,0 +1,73 @@
+// UiResources.h
+#pragma once
+#include <JuceHeader.h>
+#include <memory>
+#include "LookAndFeel.h"
+
+// Draws the editors with OpenGL; 0 builds without. The renderer is chosen in
+// the editor's context menu and kept in the user's settings file;
+// HUMANIZER_RENDERER=software or =opengl in the environment overrides it.
+#ifndef HUMANIZER_OPENGL
+ #define HUMANIZER_OPENGL 1
+#endif
+
+// What every open editor shares, held through SharedResourcePointer: the
+// first editor creates it and the last one to close releases it. Knob frames
+// are cached in the look and feel, so they are rendered once per process.
+// The tooltip window is only created once an editor is actually shown.
+class UiResources {
+public:
+	enum class Renderer { openGL, software };
+
+	ModernLookAndFeel lookAndFeel;
+	// Scaled with withHeight where used
+	const Font labelFont { FontOptions(14.0f).withStyle("Regular") };
+
+	// Desktop tooltip window serving every editor
+	void showTooltips() {
+		if (tooltipWindow == nullptr)
+			tooltipWindow = std::make_unique<TooltipWindow>(nullptr, 1500);
+	}
+
+	Renderer getRenderer() {
+	   #if HUMANIZER_OPENGL
+		const auto forced = SystemStats::getEnvironmentVariable("HUMANIZER_RENDERER", {});
+		if (forced.equalsIgnoreCase("software"))
+			return Renderer::software;
+		if (forced.equalsIgnoreCase("opengl"))
+			return Renderer::openGL;
+		return getSettings().getBoolValue(rendererKey, true) ? Renderer::openGL : Renderer::software;
+	   #else
+		return Renderer::software;
+	   #endif
+	}
+
+	// Kept for every instance and later sessions
+	void setRenderer(Renderer renderer) {
+		getSettings().setValue(rendererKey, renderer == Renderer::openGL);
+		getSettings().saveIfNeeded();
+	}
+
+	static bool canChooseRenderer() {
+		return HUMANIZER_OPENGL && SystemStats::getEnvironmentVariable("HUMANIZER_RENDERER", {}).isEmpty();
+	}
+
+private:
+	static constexpr const char* rendererKey = "openGL";
+
+	std::unique_ptr<TooltipWindow> tooltipWindow;
+	// Read on first use, editors that never ask don't touch the disk
+	std::unique_ptr<PropertiesFile> settings;
+
+	PropertiesFile& getSettings() {
+		if (settings == nullptr) {
+			PropertiesFile::Options options;
+			options.applicationName = "Humanizer";
+			options.filenameSuffix = ".settings";
+			options.folderName = "Humanizer";
+			options.osxLibrarySubFolder = "Application Support";
+			settings = std::make_unique<PropertiesFile>(options);
+		}
+		return *settings;
+	}
+};
@@ -0,0 +1,368 @@
+// BatchRenderer.cpp
+// Humanizes audio files offline with the plugin's own processor.
+//
+// HumanizerBatch --tempo=120 --seed=1234 [--range=20] [--center=0] [--speed=2] [--spread=0]
+//                [--shape=Bezier|Smooth|Drift|Stepped|Swing|Groove] [--groove=reference.wav] [--groove-start=seconds]
+//                [--interpolation=Linear|Lagrange|Sinc] [--threads=N] [--block=512]
+//                [--realtime | --compare] [--output=dir] [--profile=profile.json] file...
+//
+// By default the offline tier renders, like a host's offline bounce: outside
+// Late Only it is oversampled and lines up in time with live playback, but is
+// not bit-identical to it. --realtime renders the real-time tier instead,
+// which is bit-identical to live playback at the same block size, tempo and
+// seed without automation. --compare renders the real-time tier alongside
+// the offline one and prints the peak difference between the two.
+//
+// --groove-start is where beat 0 of the reference is; without it the first
+// onset is taken.
+//
+// --profile writes the processBlock counters of every worker, in builds with
+// HUMANIZER_PROFILING; the load is against real time, so an offline render
+// well below 100 % could also run live.
+#include <JuceHeader.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "PluginProcessor.h"
+#include "GrooveAnalyzer.h"
+#include "OfflinePlayHead.h"
+
+namespace {
+	struct RenderSettings {
+		double bpm = 120.0;
+		int seed = 0;
+		int blockSize = 512;
+		File outputDir;
+		// Parameter name -> plain value
+		StringPairArray parameters;
+		// Analysed from --groove once, played by the Groove shape
+		GrooveMap groove;
+		bool realtime = false;
+		bool compare = false;
+	};
+
+	void applyParameters(Humanizer& processor, const RenderSettings& settings) {
+		for (auto& name : settings.parameters.getAllKeys()) {
+			auto* parameter = processor.apvts.getParameter(name);
+			if (parameter == nullptr)
+				continue;
+
+			auto text = settings.parameters[name];
+			float value = text.getFloatValue();
+			if (name == PluginConfig::interpolation.name && PluginConfig::interpolationTypes.contains(text, true))
+				value = static_cast<float>(PluginConfig::interpolationTypes.indexOf(text, true));
+			if (name == PluginConfig::shape.name && PluginConfig::shapeTypes.contains(text, true))
+				value = static_cast<float>(PluginConfig::shapeTypes.indexOf(text, true));
+
+			// Workers are no place for host notifications and listeners; the
+			// processor reads the raw value, and prepareToPlay picks it up
+			parameter->setValue(parameter->convertTo0to1(value));
+			if (auto* raw = processor.apvts.getRawParameterValue(name))
+				*raw = parameter->convertFrom0to1(parameter->getValue());
+		}
+
+		processor.curveGen.seed = settings.seed;
+		processor.setGrooveMap(settings.groove);
+	}
+
+	File getOutputFile(const File& input, const RenderSettings& settings) {
+		if (settings.outputDir != File())
+			return settings.outputDir.getChildFile(input.getFileName());
+
+		return input.getSiblingFile(input.getFileNameWithoutExtension() + "_humanized" + input.getFileExtension());
+	}
+
+	// Streams a reader through one processor in blockSize blocks, so memory
+	// doesn't depend on the file length. Blocks always start at multiples of
+	// blockSize, as they would live; the first getLatencySamples() output
+	// samples are dropped and the tail is flushed, like a host's offline bounce.
+	class Render {
+		Humanizer& processor;
+		AudioFormatReader& reader;
+		OfflinePlayHead playHead;
+		const int blockSize;
+		AudioBuffer<float> block;
+		MidiBuffer midi;
+		// Output processed but not read yet, at most two blocks
+		AudioBuffer<float> pending;
+		int numPending = 0;
+		int64 latency = 0;
+		int64 readPos = 0;
+
+	public:
+		Render(Humanizer& p, AudioFormatReader& r, const RenderSettings& settings, bool nonRealtime)
+			: processor(p), reader(r), blockSize(settings.blockSize),
+			  block(static_cast<int>(r.numChannels), settings.blockSize),
+			  pending(static_cast<int>(r.numChannels), settings.blockSize * 2) {
+			playHead.bpm = settings.bpm;
+			playHead.sampleRate = reader.sampleRate;
+
+			processor.setPlayHead(&playHead);
+			processor.setNonRealtime(nonRealtime);
+			processor.setRateAndBufferSizeDetails(reader.sampleRate, blockSize);
+			applyParameters(processor, settings);
+			processor.prepareToPlay(reader.sampleRate, blockSize);
+			latency = processor.getLatencySamples();
+		}
+
+		~Render() {
+			processor.releaseResources();
+			processor.setPlayHead(nullptr);
+		}
+
+		// The next numSamples output samples, at most blockSize, into dest
+		void read(AudioBuffer<float>& dest, int numSamples) {
+			jassert(numSamples <= blockSize);
+
+			while (numPending < numSamples) {
+				// Reading past the end fills zeros, which flushes the delay line
+				reader.read(&block, 0, blockSize, readPos, true, true);
+				playHead.timeInSamples = readPos;
+				processor.processBlock(block, midi);
+
+				const int skip = static_cast<int>(jlimit<int64>(0, blockSize, latency - readPos));
+				for (int ch = 0; ch < pending.getNumChannels(); ++ch)
+					pending.copyFrom(ch, numPending, block, ch, skip, blockSize - skip);
+				numPending += blockSize - skip;
+				readPos += blockSize;
+			}
+
+			for (int ch = 0; ch < pending.getNumChannels(); ++ch) {
+				dest.copyFrom(ch, 0, pending, ch, 0, numSamples);
+				float* samples = pending.getWritePointer(ch);
+				std::copy(samples + numSamples, samples + numPending, samples);
+			}
+			numPending -= numSamples;
+		}
+	};
+
+	// Renders one file. reference, if given, renders the real-time tier of the
+	// same file, and peakDifference receives the largest difference to it.
+	String renderFile(Humanizer& processor, Humanizer* reference, AudioFormatManager& formats, const File& input,
+					  const RenderSettings& settings, float& peakDifference) {
+		std::unique_ptr<AudioFormatReader> reader(formats.createReaderFor(input));
+		if (reader == nullptr)
+			return "cannot read " + input.getFullPathName();
+
+		const int numChannels = static_cast<int>(reader->numChannels);
+		const auto channelSet = AudioChannelSet::canonicalChannelSet(numChannels);
+
+		AudioProcessor::BusesLayout layout;
+		layout.inputBuses.add(channelSet);
+		layout.outputBuses.add(channelSet);
+		if (!processor.setBusesLayout(layout) || (reference != nullptr && !reference->setBusesLayout(layout)))
+			return "unsupported channel count " + String(numChannels) + " in " + input.getFullPathName();
+
+		// Its own reader, the two renders read at different positions
+		std::unique_ptr<AudioFormatReader> referenceReader;
+		if (reference != nullptr) {
+			referenceReader.reset(formats.createReaderFor(input));
+			if (referenceReader == nullptr)
+				return "cannot read " + input.getFullPathName();
+		}
+
+		auto output = getOutputFile(input, settings);
+		if (output == input)
+			return "refusing to overwrite " + input.getFullPathName();
+
+		output.deleteFile();
+		std::unique_ptr<FileOutputStream> stream(output.createOutputStream());
+		auto* format = formats.findFormatForFileExtension(output.getFileExtension());
+		if (stream == nullptr || format == nullptr)
+			return "cannot write " + output.getFullPathName();
+
+		std::unique_ptr<AudioFormatWriter> writer(format->createWriterFor(
+			stream.get(), reader->sampleRate, static_cast<unsigned int>(numChannels),
+			static_cast<int>(reader->bitsPerSample), reader->metadataValues, 0));
+		if (writer == nullptr)
+			return "cannot write " + output.getFullPathName();
+		stream.release(); // owned by the writer now
+
+		Render render(processor, *reader, settings, !settings.realtime);
+		std::unique_ptr<Render> referenceRender;
+		if (reference != nullptr)
+			referenceRender = std::make_unique<Render>(*reference, *referenceReader, settings, false);
+
+		AudioBuffer<float> out(numChannels, settings.blockSize);
+		AudioBuffer<float> expected(numChannels, settings.blockSize);
+		const int64 length = reader->lengthInSamples;
+		peakDifference = 0.0f;
+
+		for (int64 written = 0; written < length;) {
+			const int numSamples = static_cast<int>(jmin<int64>(settings.blockSize, length - written));
+			render.read(out, numSamples);
+			if (!writer->writeFromAudioSampleBuffer(out, 0, numSamples))
+				return "write failed for " + output.getFullPathName();
+
+			if (referenceRender != nullptr) {
+				referenceRender->read(expected, numSamples);
+				for (int ch = 0; ch < numChannels; ++ch)
+					for (int i = 0; i < numSamples; ++i)
+						peakDifference = jmax(peakDifference, std::abs(out.getSample(ch, i) - expected.getSample(ch, i)));
+			}
+
+			written += numSamples;
+		}
+
+		return {};
+	}
+
+	// State the workers share
+	struct Batch {
+		const Array<File>& inputs;
+		AudioFormatManager& formats;
+		const RenderSettings& settings;
+		std::atomic<int> nextInput { 0 };
+		std::atomic<int> failures { 0 };
+		CriticalSection logLock;
+	};
+
+	// Owns a processor, and one for the comparison, and pulls files from the
+	// batch until none are left
+	class RenderJob : public ThreadPoolJob {
+		Batch& batch;
+		Humanizer& processor;
+		Humanizer* reference;
+
+	public:
+		RenderJob(Batch& b, Humanizer& p, Humanizer* r) : ThreadPoolJob("Render"), batch(b), processor(p), reference(r) {}
+
+		JobStatus runJob() override {
+			for (int i = batch.nextInput++; i < batch.inputs.size() && !shouldExit(); i = batch.nextInput++) {
+				float peakDifference = 0.0f;
+				auto error = renderFile(processor, reference, batch.formats, batch.inputs[i], batch.settings, peakDifference);
+
+				const ScopedLock sl(batch.logLock);
+				if (error.isNotEmpty()) {
+					std::cerr << error << std::endl;
+					++batch.failures;
+				}
+				else if (reference != nullptr) {
+					std::cout << batch.inputs[i].getFullPathName() << ": peak difference to the real-time tier "
+							  << Decibels::toString(Decibels::gainToDecibels(peakDifference)) << std::endl;
+				}
+				else {
+					std::cout << batch.inputs[i].getFullPathName() << std::endl;
+				}
+			}
+			return jobHasFinished;
+		}
+	};
+}
+
+int main(int argc, char* argv[]) {
+	ScopedJuceInitialiser_GUI juceInit;
+	ArgumentList args(argc, argv);
+
+	RenderSettings settings;
+	settings.bpm = args.getValueForOption("--tempo").getDoubleValue();
+	settings.seed = args.getValueForOption("--seed").getIntValue();
+	settings.blockSize = jmax(1, args.containsOption("--block") ? args.getValueForOption("--block").getIntValue() : 512);
+	settings.realtime = args.containsOption("--realtime");
+	settings.compare = args.containsOption("--compare") && !settings.realtime;
+
+	if (settings.bpm <= 0.0 || !args.containsOption("--seed")) {
+		std::cerr << "usage: HumanizerBatch --tempo=<bpm> --seed=<int> [--range=ms] [--center=-1..1] [--speed=beats] [--spread=0..1]" << std::endl
+				  << "       [--shape=Bezier|Smooth|Drift|Stepped|Swing|Groove] [--groove=reference] [--groove-start=seconds]" << std::endl
+				  << "       [--interpolation=Linear|Lagrange|Sinc] [--threads=N] [--block=samples]" << std::endl
+				  << "       [--realtime | --compare] [--output=dir] [--profile=file] file..." << std::endl;
+		return 1;
+	}
+
+	for (auto* settingsOf : { &PluginConfig::range, &PluginConfig::center, &PluginConfig::speed, &PluginConfig::spread, &PluginConfig::shape, &PluginConfig::interpolation }) {
+		const auto option = "--" + settingsOf->name.toLowerCase();
+		if (args.containsOption(option))
+			settings.parameters.set(settingsOf->name, args.getValueForOption(option));
+	}
+
+	if (args.containsOption("--groove")) {
+		GrooveAnalyzer::Settings grooveSettings;
+		grooveSettings.bpm = settings.bpm;
+		if (args.containsOption("--groove-start"))
+			grooveSettings.firstBeatSeconds = jmax(0.0, args.getValueForOption("--groove-start").getDoubleValue());
+		GrooveAnalyzer::Result result;
+
+		const auto error = GrooveAnalyzer::analyzeFile(args.getFileForOption("--groove"), grooveSettings, result);
+		if (error.isNotEmpty()) {
+			std::cerr << error << std::endl;
+			return 1;
+		}
+
+		settings.groove = result.map;
+		std::cout << "groove: " << result.numOnsets << " onsets" << std::endl;
+	}
+
+	if (args.containsOption("--output")) {
+		settings.outputDir = args.getFileForOption("--output");
+		if (!settings.outputDir.createDirectory()) {
+			std::cerr << "cannot create " << settings.outputDir.getFullPathName() << std::endl;
+			return 1;
+		}
+	}
+
+	Array<File> inputs;
+	for (auto& arg : args.arguments) {
+		if (arg.isOption())
+			continue;
+
+		auto file = arg.resolveAsFile();
+		if (!file.existsAsFile()) {
+			std::cerr << "no such file " << file.getFullPathName() << std::endl;
+			return 1;
+		}
+		inputs.add(file);
+	}
+
+	if (inputs.isEmpty()) {
+		std::cerr << "no input files" << std::endl;
+		return 1;
+	}
+
+	AudioFormatManager formats;
+	formats.registerBasicFormats();
+
+	const int numThreads = jlimit(1, inputs.size(), args.containsOption("--threads")
+		? args.getValueForOption("--threads").getIntValue()
+		: SystemStats::getNumCpus());
+
+	// Processors are created here, on the message thread; each worker owns one,
+	// and a second one with --compare
+	std::vector<std::unique_ptr<Humanizer>> processors;
+	std::vector<std::unique_ptr<Humanizer>> references;
+	for (int i = 0; i < numThreads; ++i) {
+		processors.push_back(std::make_unique<Humanizer>());
+		if (settings.compare)
+			references.push_back(std::make_unique<Humanizer>());
+	}
+
+	Batch batch { inputs, formats, settings };
+	std::vector<std::unique_ptr<RenderJob>> jobs;
+	for (int i = 0; i < numThreads; ++i)
+		jobs.push_back(std::make_unique<RenderJob>(batch, *processors[static_cast<size_t>(i)],
+			settings.compare ? references[static_cast<size_t>(i)].get() : nullptr));
+
+	{
+		ThreadPool pool(numThreads);
+		for (auto& job : jobs)
+			pool.addJob(job.get(), false);
+		for (auto& job : jobs)
+			pool.waitForJobToFinish(job.get(), -1);
+	}
+
+	if (args.containsOption("--profile")) {
+		Array<var> workers;
+		for (auto& processor : processors)
+			workers.add(processor->profiler.toJson());
+
+		const auto profileFile = args.getFileForOption("--profile");
+		if (!profileFile.replaceWithText(JSON::toString(var(workers)))) {
+			std::cerr << "cannot write " << profileFile.getFullPathName() << std::endl;
+			return 1;
+		}
+	}
+
+	return batch.failures > 0 ? 1 : 0;
+}
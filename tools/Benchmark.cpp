@@ -0,0 +1,376 @@
+// Benchmark.cpp
+// Microbenchmarks for Humanizer::processBlock, the curve of every shape,
+// saving and recalling the plugin state, and creating instances and editors.
+//
+// HumanizerBenchmark [--output=benchmark.json] [--seconds=1]
+//                    [--rates=44100,48000,...] [--blocks=1,64,...] [--channels=1,2]
+//                    [--interpolation=Linear,Lagrange,Sinc] [--no-editor]
+//
+// Every processBlock case reports ns/sample, block time percentiles and the worst block.
+// Results are written as JSON so runs can be diffed.
+#include <JuceHeader.h>
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "PluginProcessor.h"
+#include "OfflinePlayHead.h"
+
+namespace {
+	// Samples between automation events
+	constexpr int automationInterval = 64;
+
+	struct Preset {
+		const char* name;
+		float range;
+		float center;
+		float speed;
+	};
+
+	const Preset presets[] {
+		{ "narrow", 10.0f, 0.0f, 1.0f },
+		{ "wide", 200.0f, -1.0f, 4.0f },
+	};
+
+	struct Case {
+		double sampleRate;
+		int blockSize;
+		int numChannels;
+		int interpolation;
+		const Preset* preset;
+		bool automation;
+	};
+
+	struct Stats {
+		int64 samples = 0;
+		double nsPerSample = 0.0;
+		double meanBlockNs = 0.0;
+		double p50 = 0.0, p90 = 0.0, p99 = 0.0, p999 = 0.0;
+		double worstBlockNs = 0.0;
+	};
+
+	double ticksToNs(int64 ticks) {
+		return static_cast<double>(ticks) * 1.0e9 / static_cast<double>(Time::getHighResolutionTicksPerSecond());
+	}
+
+	Stats summarize(std::vector<double>& blockNs, int64 samples) {
+		Stats stats;
+		if (blockNs.empty())
+			return stats;
+
+		std::sort(blockNs.begin(), blockNs.end());
+		auto percentile = [&blockNs] (double p) {
+			auto index = static_cast<size_t>(p * static_cast<double>(blockNs.size() - 1));
+			return blockNs[index];
+		};
+
+		double total = 0.0;
+		for (auto ns : blockNs)
+			total += ns;
+
+		stats.samples = samples;
+		stats.nsPerSample = total / static_cast<double>(samples);
+		stats.meanBlockNs = total / static_cast<double>(blockNs.size());
+		stats.p50 = percentile(0.5);
+		stats.p90 = percentile(0.9);
+		stats.p99 = percentile(0.99);
+		stats.p999 = percentile(0.999);
+		stats.worstBlockNs = blockNs.back();
+		return stats;
+	}
+
+	void setParameter(Humanizer& processor, const String& name, float value) {
+		if (auto* parameter = processor.apvts.getParameter(name))
+			parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+	}
+
+	Stats runProcessBlock(Humanizer& processor, const Case& c, double seconds) {
+		const auto channelSet = AudioChannelSet::canonicalChannelSet(c.numChannels);
+		AudioProcessor::BusesLayout layout;
+		layout.inputBuses.add(channelSet);
+		layout.outputBuses.add(channelSet);
+		processor.setBusesLayout(layout);
+
+		setParameter(processor, PluginConfig::range.name, c.preset->range);
+		setParameter(processor, PluginConfig::center.name, c.preset->center);
+		setParameter(processor, PluginConfig::speed.name, c.preset->speed);
+		setParameter(processor, PluginConfig::interpolation.name, static_cast<float>(c.interpolation));
+
+		OfflinePlayHead playHead;
+		playHead.sampleRate = c.sampleRate;
+		processor.setPlayHead(&playHead);
+		processor.setRateAndBufferSizeDetails(c.sampleRate, c.blockSize);
+		processor.prepareToPlay(c.sampleRate, c.blockSize);
+
+		AudioBuffer<float> buffer(c.numChannels, c.blockSize);
+		MidiBuffer midi;
+		Random random(1234);
+
+		const int64 totalSamples = static_cast<int64>(seconds * c.sampleRate);
+		const int64 numBlocks = jmax<int64>(1, totalSamples / c.blockSize);
+		const int64 warmupBlocks = jmin<int64>(numBlocks, 64);
+		std::vector<double> blockNs;
+		blockNs.reserve(static_cast<size_t>(numBlocks));
+
+		for (int64 block = -warmupBlocks; block < numBlocks; ++block) {
+			for (int ch = 0; ch < c.numChannels; ++ch)
+				for (int i = 0; i < c.blockSize; ++i)
+					buffer.setSample(ch, i, random.nextFloat() * 2.0f - 1.0f);
+
+			if (c.automation) {
+				// Sweep Speed and Range once per second of audio, with a change every
+				// automationInterval samples like sample-accurate host automation
+				for (int offset = 0; offset < c.blockSize; offset += automationInterval) {
+					const double phase = static_cast<double>(playHead.timeInSamples + offset) / c.sampleRate * MathConstants<double>::twoPi;
+					const float sweep = static_cast<float>(0.5 + 0.5 * std::sin(phase));
+					const float speed = jmap(sweep, PluginConfig::speed.min, PluginConfig::speed.max);
+					const float range = jmap(sweep, 0.0f, c.preset->range);
+					processor.addParameterEvent(PluginConfig::speed, offset, speed);
+					processor.addParameterEvent(PluginConfig::range, offset, range);
+					setParameter(processor, PluginConfig::speed.name, speed);
+					setParameter(processor, PluginConfig::range.name, range);
+				}
+			}
+
+			const auto start = Time::getHighResolutionTicks();
+			processor.processBlock(buffer, midi);
+			const auto end = Time::getHighResolutionTicks();
+
+			if (block >= 0)
+				blockNs.push_back(ticksToNs(end - start));
+			playHead.timeInSamples += c.blockSize;
+		}
+
+		processor.releaseResources();
+		processor.setPlayHead(nullptr);
+		return summarize(blockNs, numBlocks * c.blockSize);
+	}
+
+	// Per-sample getValue against generateBlock over the same span of beats
+	var runCurve(Humanizer& processor, double sampleRate, int shape, double seconds) {
+		setParameter(processor, PluginConfig::shape.name, static_cast<float>(shape));
+		const double beatIncrement = 120.0 / 60.0 / sampleRate;
+		const int numSamples = static_cast<int>(seconds * sampleRate);
+		std::vector<float> out(static_cast<size_t>(numSamples));
+
+		auto start = Time::getHighResolutionTicks();
+		double beat = 0.0;
+		for (int i = 0; i < numSamples; ++i, beat += beatIncrement)
+			out[static_cast<size_t>(i)] = static_cast<float>(processor.curveGen.getValue(beat));
+		const double perSampleNs = ticksToNs(Time::getHighResolutionTicks() - start) / numSamples;
+
+		start = Time::getHighResolutionTicks();
+		processor.curveGen.generateBlock(0.0, beatIncrement, out.data(), numSamples);
+		const double blockNs = ticksToNs(Time::getHighResolutionTicks() - start) / numSamples;
+
+		auto* result = new DynamicObject();
+		result->setProperty("sampleRate", sampleRate);
+		result->setProperty("shape", PluginConfig::shapeTypes[shape]);
+		result->setProperty("getValueNsPerSample", perSampleNs);
+		result->setProperty("generateBlockNsPerSample", blockNs);
+		return var(result);
+	}
+
+	// The state as sessions stored it before the binary format
+	void getXmlState(Humanizer& processor, MemoryBlock& dest) {
+		auto state = processor.apvts.copyState();
+		state.setProperty("seed", processor.curveGen.seed.load(), nullptr);
+		std::unique_ptr<XmlElement> xml(state.createXml());
+		AudioProcessor::copyXmlToBinary(*xml, dest);
+	}
+
+	// Save and recall of the binary state, and recall of the XML fallback.
+	// Recalls alternate between two states, so every parameter changes.
+	var runState(Humanizer& processor, int iterations) {
+		MemoryBlock states[2], xmlStates[2];
+		for (int i = 0; i < 2; ++i) {
+			setParameter(processor, PluginConfig::range.name, i == 0 ? 10.0f : 200.0f);
+			setParameter(processor, PluginConfig::center.name, i == 0 ? 0.0f : -1.0f);
+			setParameter(processor, PluginConfig::speed.name, i == 0 ? 1.0f : 4.0f);
+			setParameter(processor, PluginConfig::shape.name, static_cast<float>(i));
+			processor.curveGen.seed = i == 0 ? 1234 : 2147480001;
+			processor.getStateInformation(states[i]);
+			getXmlState(processor, xmlStates[i]);
+		}
+
+		auto timeNs = [iterations] (auto&& fn) {
+			const auto start = Time::getHighResolutionTicks();
+			for (int i = 0; i < iterations; ++i)
+				fn(i & 1);
+			return ticksToNs(Time::getHighResolutionTicks() - start) / iterations;
+		};
+
+		MemoryBlock saved;
+		const double saveNs = timeNs([&] (int) { processor.getStateInformation(saved); });
+		const double loadNs = timeNs([&] (int i) { processor.setStateInformation(states[i].getData(), static_cast<int>(states[i].getSize())); });
+		const double xmlLoadNs = timeNs([&] (int i) { processor.setStateInformation(xmlStates[i].getData(), static_cast<int>(xmlStates[i].getSize())); });
+
+		auto* result = new DynamicObject();
+		result->setProperty("iterations", iterations);
+		result->setProperty("bytes", static_cast<int>(states[0].getSize()));
+		result->setProperty("xmlBytes", static_cast<int>(xmlStates[0].getSize()));
+		result->setProperty("saveNs", saveNs);
+		result->setProperty("loadNs", loadNs);
+		result->setProperty("xmlLoadNs", xmlLoadNs);
+		// Both recall paths must end up with the seed in full
+		result->setProperty("seedRecalled", processor.curveGen.seed == 2147480001);
+
+		std::cout << "state: save " << saveNs << " ns, load " << loadNs << " ns (" << states[0].getSize()
+				  << " bytes), xml load " << xmlLoadNs << " ns (" << xmlStates[0].getSize() << " bytes)" << std::endl;
+		return var(result);
+	}
+
+	// Threads of the process, or -1 where they can't be counted
+	int countThreads() {
+	   #if JUCE_LINUX
+		return File("/proc/self/task").getNumberOfChildFiles(File::findDirectories);
+	   #else
+		return -1;
+	   #endif
+	}
+
+	// Creating and destroying instances, as a scan or a large template does, and
+	// editors that are never shown, on their own and while another one is open.
+	// A hidden editor should start no threads; the groove analysis pool waits
+	// for the first analysis.
+	var runFootprint(int iterations, bool withEditors) {
+		auto timeNs = [] (int count, auto&& fn) {
+			const auto start = Time::getHighResolutionTicks();
+			for (int i = 0; i < count; ++i)
+				fn();
+			return ticksToNs(Time::getHighResolutionTicks() - start) / count;
+		};
+
+		auto* result = new DynamicObject();
+		result->setProperty("iterations", iterations);
+		result->setProperty("instanceNs", timeNs(iterations, [] { auto instance = std::make_unique<Humanizer>(); }));
+		std::cout << "instance: " << static_cast<double>(result->getProperty("instanceNs")) << " ns";
+
+		if (withEditors) {
+			Humanizer processor;
+			const double firstNs = timeNs(1, [&] { std::unique_ptr<AudioProcessorEditor> editor(processor.createEditor()); });
+			const double editorNs = timeNs(iterations, [&] { std::unique_ptr<AudioProcessorEditor> editor(processor.createEditor()); });
+
+			// Shared resources stay alive while one editor is open
+			Humanizer other;
+			std::unique_ptr<AudioProcessorEditor> open(other.createEditor());
+			const double sharedNs = timeNs(iterations, [&] { std::unique_ptr<AudioProcessorEditor> editor(processor.createEditor()); });
+			open.reset();
+
+			// Threads started by a hidden editor, counted while it exists
+			const int threadsBefore = countThreads();
+			std::unique_ptr<AudioProcessorEditor> hidden(processor.createEditor());
+			const int editorThreads = threadsBefore < 0 ? -1 : countThreads() - threadsBefore;
+			hidden.reset();
+
+			result->setProperty("firstEditorNs", firstNs);
+			result->setProperty("editorNs", editorNs);
+			result->setProperty("editorWhileOpenNs", sharedNs);
+			result->setProperty("editorThreads", editorThreads);
+			std::cout << ", first editor " << firstNs << " ns, editor " << editorNs << " ns, editor while another is open " << sharedNs << " ns";
+			if (editorThreads >= 0)
+				std::cout << ", " << editorThreads << " threads per hidden editor";
+		}
+
+		std::cout << std::endl;
+		return var(result);
+	}
+
+	template <typename T>
+	Array<T> parseList(const ArgumentList& args, const String& option, Array<T> fallback) {
+		if (!args.containsOption(option))
+			return fallback;
+
+		Array<T> values;
+		for (auto& token : StringArray::fromTokens(args.getValueForOption(option), ",", {}))
+			values.add(static_cast<T>(token.getDoubleValue()));
+		return values;
+	}
+}
+
+int main(int argc, char* argv[]) {
+	ScopedJuceInitialiser_GUI juceInit;
+	ArgumentList args(argc, argv);
+
+	const double seconds = args.containsOption("--seconds") ? args.getValueForOption("--seconds").getDoubleValue() : 1.0;
+	const File output = args.containsOption("--output")
+		? args.getFileForOption("--output")
+		: File::getCurrentWorkingDirectory().getChildFile("benchmark.json");
+
+	const auto sampleRates = parseList<double>(args, "--rates", { 44100.0, 48000.0, 96000.0, 192000.0, 384000.0 });
+	const auto blockSizes = parseList<int>(args, "--blocks", { 1, 16, 64, 128, 256, 512, 1024, 4096 });
+	const auto channels = parseList<int>(args, "--channels", { 1, 2 });
+
+	Array<int> interpolations { 0, 1, 2 };
+	if (args.containsOption("--interpolation")) {
+		interpolations.clear();
+		for (auto& token : StringArray::fromTokens(args.getValueForOption("--interpolation"), ",", {}))
+			interpolations.addIfNotAlreadyThere(jmax(0, PluginConfig::interpolationTypes.indexOf(token, true)));
+	}
+
+	Humanizer processor;
+	processor.curveGen.seed = 1234;
+	processor.setNonRealtime(false);
+
+	Array<var> cases;
+	std::cout << "rate\tblock\tch\tinterp\tpreset\tauto\tns/sample\tp50\tp99\tworst (ns/block)" << std::endl;
+
+	for (auto sampleRate : sampleRates)
+	for (auto blockSize : blockSizes)
+	for (auto numChannels : channels)
+	for (auto interpolation : interpolations)
+	for (auto& preset : presets)
+	for (bool automation : { false, true }) {
+		const Case c { sampleRate, jmax(1, blockSize), jmax(1, numChannels), interpolation, &preset, automation };
+		processor.profiler.reset();
+		const auto stats = runProcessBlock(processor, c, seconds);
+		const auto interpolationName = PluginConfig::interpolationTypes[interpolation];
+
+		auto* result = new DynamicObject();
+		result->setProperty("sampleRate", c.sampleRate);
+		result->setProperty("blockSize", c.blockSize);
+		result->setProperty("channels", c.numChannels);
+		result->setProperty("interpolation", interpolationName);
+		result->setProperty("preset", String(preset.name));
+		result->setProperty("automation", automation);
+		result->setProperty("samples", stats.samples);
+		result->setProperty("nsPerSample", stats.nsPerSample);
+		result->setProperty("meanBlockNs", stats.meanBlockNs);
+		result->setProperty("p50BlockNs", stats.p50);
+		result->setProperty("p90BlockNs", stats.p90);
+		result->setProperty("p99BlockNs", stats.p99);
+		result->setProperty("p999BlockNs", stats.p999);
+		result->setProperty("worstBlockNs", stats.worstBlockNs);
+		// The plugin's own counters, including the warm-up blocks
+		result->setProperty("profiler", processor.profiler.toJson());
+		cases.add(var(result));
+
+		std::cout << c.sampleRate << "\t" << c.blockSize << "\t" << c.numChannels << "\t" << interpolationName
+				  << "\t" << preset.name << "\t" << (automation ? "on" : "off")
+				  << "\t" << stats.nsPerSample << "\t" << stats.p50 << "\t" << stats.p99 << "\t" << stats.worstBlockNs << std::endl;
+	}
+
+	Array<var> curve;
+	for (auto sampleRate : sampleRates)
+		for (int shape = 0; shape < PluginConfig::shapeTypes.size(); ++shape)
+			curve.add(runCurve(processor, sampleRate, shape, seconds));
+
+	const var state = runState(processor, 1000);
+	const var footprint = runFootprint(50, !args.containsOption("--no-editor"));
+
+	auto* root = new DynamicObject();
+	root->setProperty("version", 1);
+	root->setProperty("cpu", SystemStats::getCpuModel());
+	root->setProperty("processBlock", cases);
+	root->setProperty("curve", curve);
+	root->setProperty("state", state);
+	root->setProperty("footprint", footprint);
+
+	if (!output.replaceWithText(JSON::toString(var(root)))) {
+		std::cerr << "cannot write " << output.getFullPathName() << std::endl;
+		return 1;
+	}
+
+	std::cout << "results written to " << output.getFullPathName() << std::endl;
+	return 0;
+}
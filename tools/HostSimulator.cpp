@@ -0,0 +1,814 @@
+// HostSimulator.cpp
+// Headless host simulator: runs N processors as one parallel graph on worker
+// threads and replays a script of transport, automation and buffer size
+// changes, the way a DAW drives plugins. No audio device is opened; every
+// graph cycle is timed against the deadline its block has in real time.
+//
+// HumanizerHostSim [--instances=16] [--threads=N] [--pokers=1] [--seed=1]
+//                  [--script=script.txt] [--output=hostsim.json] [--strict]
+//
+// Reports deadline misses of the whole graph, the worst block of any
+// instance, and heap allocations made inside processBlock. --strict exits
+// with 1 if any block allocated or missed its deadline.
+//
+// A script has one command per line, at a time in seconds of simulated audio:
+//
+//   0    rate 48000               prepares every instance at this rate
+//   0    blocks 256 64 480        block sizes, used in turn
+//   1    blocks random 1 1024     a random size every cycle
+//   0    tempo 120
+//   0    play / stop
+//   2    jump 64                  moves the transport to this ppq
+//   2    loop 8 16 / loop off     loop points in ppq
+//   3    automate Speed 1 8 2     triangle sweep between two values over a period in seconds
+//   3    automate Speed off
+//   4    program 3                program change, sent on the audio thread
+//   5    reprepare                releaseResources and prepareToPlay again
+//   9    end
+//
+// Names with spaces are quoted, e.g. automate "Max Range" 0 5 4.
+#include <JuceHeader.h>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+#include "PluginProcessor.h"
+
+//==============================================================================
+// Allocations are counted per thread while countAllocations is set, around
+// processBlock. glibc's allocator is wrapped, aligned entry points included,
+// so that malloc from JUCE's HeapBlock is seen as well as every operator new;
+// elsewhere every form of operator new and delete is replaced and only those
+// are counted.
+namespace {
+	thread_local bool countAllocations = false;
+	thread_local int64 allocations = 0;
+}
+
+#if defined(__GLIBC__)
+extern "C" {
+	void* __libc_malloc(size_t);
+	void* __libc_calloc(size_t, size_t);
+	void* __libc_realloc(void*, size_t);
+	void* __libc_memalign(size_t, size_t);
+
+	void* malloc(size_t size) noexcept {
+		if (countAllocations)
+			++allocations;
+		return __libc_malloc(size);
+	}
+
+	void* calloc(size_t count, size_t size) noexcept {
+		if (countAllocations)
+			++allocations;
+		return __libc_calloc(count, size);
+	}
+
+	void* realloc(void* pointer, size_t size) noexcept {
+		if (countAllocations)
+			++allocations;
+		return __libc_realloc(pointer, size);
+	}
+
+	// Aligned operator new and RingPool come through these
+	void* memalign(size_t alignment, size_t size) noexcept {
+		if (countAllocations)
+			++allocations;
+		return __libc_memalign(alignment, size);
+	}
+
+	void* aligned_alloc(size_t alignment, size_t size) noexcept {
+		return memalign(alignment, size);
+	}
+
+	int posix_memalign(void** pointer, size_t alignment, size_t size) noexcept {
+		if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+			return EINVAL;
+		void* memory = memalign(alignment, size);
+		if (memory == nullptr)
+			return ENOMEM;
+		*pointer = memory;
+		return 0;
+	}
+}
+#else
+namespace {
+	void* allocate(std::size_t size, std::size_t alignment) noexcept {
+		if (countAllocations)
+			++allocations;
+		size = size > 0 ? size : 1;
+		if (alignment <= alignof(std::max_align_t))
+			return std::malloc(size);
+
+	   #if JUCE_WINDOWS
+		return _aligned_malloc(size, alignment);
+	   #else
+		void* memory = nullptr;
+		return posix_memalign(&memory, alignment, size) == 0 ? memory : nullptr;
+	   #endif
+	}
+
+	void release(void* pointer, std::size_t alignment) noexcept {
+	   #if JUCE_WINDOWS
+		if (alignment > alignof(std::max_align_t)) {
+			_aligned_free(pointer);
+			return;
+		}
+	   #endif
+		ignoreUnused(alignment);
+		std::free(pointer);
+	}
+
+	void* allocateOrThrow(std::size_t size, std::size_t alignment) {
+		if (void* pointer = allocate(size, alignment))
+			return pointer;
+		throw std::bad_alloc();
+	}
+
+	constexpr std::size_t defaultAlignment = alignof(std::max_align_t);
+}
+
+void* operator new(std::size_t size) { return allocateOrThrow(size, defaultAlignment); }
+void* operator new[](std::size_t size) { return allocateOrThrow(size, defaultAlignment); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return allocate(size, defaultAlignment); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return allocate(size, defaultAlignment); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return allocateOrThrow(size, static_cast<std::size_t>(alignment)); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return allocateOrThrow(size, static_cast<std::size_t>(alignment)); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocate(size, static_cast<std::size_t>(alignment)); }
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocate(size, static_cast<std::size_t>(alignment)); }
+
+void operator delete(void* pointer) noexcept { release(pointer, defaultAlignment); }
+void operator delete[](void* pointer) noexcept { release(pointer, defaultAlignment); }
+void operator delete(void* pointer, std::size_t) noexcept { release(pointer, defaultAlignment); }
+void operator delete[](void* pointer, std::size_t) noexcept { release(pointer, defaultAlignment); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { release(pointer, defaultAlignment); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { release(pointer, defaultAlignment); }
+void operator delete(void* pointer, std::align_val_t alignment) noexcept { release(pointer, static_cast<std::size_t>(alignment)); }
+void operator delete[](void* pointer, std::align_val_t alignment) noexcept { release(pointer, static_cast<std::size_t>(alignment)); }
+void operator delete(void* pointer, std::size_t, std::align_val_t alignment) noexcept { release(pointer, static_cast<std::size_t>(alignment)); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t alignment) noexcept { release(pointer, static_cast<std::size_t>(alignment)); }
+void operator delete(void* pointer, std::align_val_t alignment, const std::nothrow_t&) noexcept { release(pointer, static_cast<std::size_t>(alignment)); }
+void operator delete[](void* pointer, std::align_val_t alignment, const std::nothrow_t&) noexcept { release(pointer, static_cast<std::size_t>(alignment)); }
+#endif
+
+namespace {
+	const char* const defaultScript = R"(
+0     rate 48000
+0     blocks 256
+0     tempo 120
+0     play
+0     automate Speed 1 8 3
+1     blocks 64 128 32 480 512 1
+2     loop 8 16
+3     blocks random 1 1024
+4     loop off
+4     jump 1000
+4.5   automate Range 0 200 1.5
+5     program 3
+5.5   stop
+6     play
+6     tempo 174
+6.5   program 5
+7     rate 96000
+7     blocks 32 4096
+8     reprepare
+8.5   rate 44100
+8.5   blocks random 16 2048
+8.5   automate Spread 0 1 0.7
+9     program 0
+10    end
+)";
+
+	// Samples between automation events inside a block
+	constexpr int automationInterval = 64;
+	// Programs filled with random settings before the run
+	constexpr int numPrograms = 8;
+
+	struct Command {
+		double time = 0.0;
+		StringArray tokens;
+	};
+
+	bool parseScript(const String& text, std::vector<Command>& commands, String& error) {
+		int lineNumber = 0;
+		for (auto line : StringArray::fromLines(text)) {
+			++lineNumber;
+			line = line.upToFirstOccurrenceOf("#", false, false).trim();
+			if (line.isEmpty())
+				continue;
+
+			StringArray tokens;
+			tokens.addTokens(line, " \t", "\"");
+			tokens.removeEmptyStrings();
+			for (auto& token : tokens)
+				token = token.unquoted();
+
+			if (tokens.size() < 2 || !tokens[0].containsOnly("0123456789.")) {
+				error = "line " + String(lineNumber) + ": expected a time and a command";
+				return false;
+			}
+
+			Command command;
+			command.time = tokens[0].getDoubleValue();
+			tokens.remove(0);
+			command.tokens = tokens;
+			if (!commands.empty() && command.time < commands.back().time) {
+				error = "line " + String(lineNumber) + ": times must not go back";
+				return false;
+			}
+			commands.push_back(std::move(command));
+		}
+
+		if (commands.empty() || commands.back().tokens[0] != "end") {
+			error = "must finish with end";
+			return false;
+		}
+		return true;
+	}
+
+	// The host's transport. Written between cycles, read by every instance during one.
+	class SimulatedPlayHead : public AudioPlayHead {
+	public:
+		double bpm = 120.0;
+		double ppq = 0.0;
+		int64 timeInSamples = 0;
+		double sampleRate = 48000.0;
+		bool isPlaying = false;
+		bool isLooping = false;
+		double loopStart = 0.0, loopEnd = 0.0;
+
+		Optional<PositionInfo> getPosition() const override {
+			PositionInfo info;
+			info.setBpm(bpm);
+			info.setTimeInSamples(timeInSamples);
+			info.setTimeInSeconds(static_cast<double>(timeInSamples) / sampleRate);
+			info.setPpqPosition(ppq);
+			info.setIsPlaying(isPlaying);
+			info.setIsLooping(isLooping);
+			info.setLoopPoints(LoopPoints { loopStart, loopEnd });
+			return info;
+		}
+
+		void advance(int numSamples) {
+			if (!isPlaying)
+				return;
+
+			timeInSamples += numSamples;
+			ppq += numSamples / sampleRate * bpm / 60.0;
+			if (isLooping && loopEnd > loopStart && ppq >= loopEnd)
+				ppq = loopStart + std::fmod(ppq - loopStart, loopEnd - loopStart);
+		}
+	};
+
+	// What every instance does in one cycle, set by the coordinator
+	struct Cycle {
+		int blockSize = 0;
+		double sampleRate = 48000.0;
+		double deadlineNs = 0.0;
+		double startSeconds = 0.0;
+		int program = -1;
+		// Value at the start and per-sample slope of every automated parameter, NaN if not automated
+		float automation[StateFormat::numParameters];
+		float automationSlope[StateFormat::numParameters];
+	};
+
+	struct Instance {
+		std::unique_ptr<Humanizer> processor;
+		RangedAudioParameter* parameters[StateFormat::numParameters] {};
+		AudioBuffer<float> buffer;
+		MidiBuffer midi;
+		Random random;
+
+		// Written by the worker that ran it, read by the coordinator between cycles
+		int64 blocks = 0;
+		int64 allocations = 0;
+		int64 blocksWithAllocations = 0;
+		int64 maxAllocations = 0;
+		double worstNs = 0.0;
+		double worstLoad = 0.0;
+		int worstBlockSize = 0;
+		double worstSeconds = 0.0;
+		int64 suspendedBlocks = 0;
+	};
+
+	void processInstance(Instance& instance, const Cycle& cycle) {
+		auto& processor = *instance.processor;
+		AudioBuffer<float> block(instance.buffer.getArrayOfWritePointers(), instance.buffer.getNumChannels(), cycle.blockSize);
+
+		// As a plugin wrapper does: the callback lock, and silence while suspended
+		const ScopedLock lock(processor.getCallbackLock());
+		if (processor.isSuspended()) {
+			block.clear();
+			++instance.suspendedBlocks;
+			return;
+		}
+
+		// Host automation is applied on the audio thread, ramps as sample-accurate events
+		for (int i = 0; i < StateFormat::numParameters; ++i) {
+			const float value = cycle.automation[i];
+			if (std::isnan(value))
+				continue;
+
+			const auto& settings = *StateFormat::parameters[i];
+			float last = value;
+			for (int offset = 0; offset < cycle.blockSize; offset += automationInterval) {
+				last = jlimit(settings.min, settings.max, value + cycle.automationSlope[i] * static_cast<float>(offset));
+				processor.addParameterEvent(settings, offset, last);
+			}
+			auto* parameter = instance.parameters[i];
+			parameter->setValueNotifyingHost(parameter->convertTo0to1(last));
+		}
+		if (cycle.program >= 0)
+			processor.setCurrentProgram(cycle.program);
+
+		for (int ch = 0; ch < block.getNumChannels(); ++ch)
+			for (int i = 0; i < cycle.blockSize; ++i)
+				block.setSample(ch, i, instance.random.nextFloat() * 2.0f - 1.0f);
+		instance.midi.clear();
+
+		const int64 allocationsBefore = allocations;
+		countAllocations = true;
+		const auto start = Time::getHighResolutionTicks();
+		processor.processBlock(block, instance.midi);
+		const auto end = Time::getHighResolutionTicks();
+		countAllocations = false;
+
+		const int64 allocated = allocations - allocationsBefore;
+		const double ns = static_cast<double>(end - start) * 1.0e9 / static_cast<double>(Time::getHighResolutionTicksPerSecond());
+
+		++instance.blocks;
+		instance.allocations += allocated;
+		if (allocated > 0)
+			++instance.blocksWithAllocations;
+		instance.maxAllocations = jmax(instance.maxAllocations, allocated);
+		if (ns > instance.worstNs) {
+			instance.worstNs = ns;
+			instance.worstLoad = ns / cycle.deadlineNs;
+			instance.worstBlockSize = cycle.blockSize;
+			instance.worstSeconds = cycle.startSeconds;
+		}
+	}
+
+	// Worker threads that take instances from a shared counter each cycle,
+	// like a DAW's parallel graph
+	class Graph {
+	public:
+		Graph(std::vector<Instance>& graphInstances, int numThreads) : instances(graphInstances) {
+			for (int i = 0; i < numThreads; ++i)
+				workers.emplace_back([this] { workerLoop(); });
+		}
+
+		~Graph() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				quit = true;
+			}
+			started.notify_all();
+			for (auto& worker : workers)
+				worker.join();
+		}
+
+		// Runs every instance once and returns when all are done
+		void run(const Cycle& next) {
+			cycle = &next;
+			nextInstance = 0;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				workersDone = 0;
+				++generation;
+			}
+			started.notify_all();
+
+			std::unique_lock<std::mutex> lock(mutex);
+			done.wait(lock, [this] { return workersDone == static_cast<int>(workers.size()); });
+		}
+
+	private:
+		std::vector<Instance>& instances;
+		std::vector<std::thread> workers;
+		std::mutex mutex;
+		std::condition_variable started, done;
+		uint64 generation = 0;
+		int workersDone = 0;
+		bool quit = false;
+		const Cycle* cycle = nullptr;
+		std::atomic<int> nextInstance { 0 };
+
+		void workerLoop() {
+			uint64 seen = 0;
+			for (;;) {
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					started.wait(lock, [&] { return quit || generation != seen; });
+					if (quit)
+						return;
+					seen = generation;
+				}
+
+				const int numInstances = static_cast<int>(instances.size());
+				for (int i = nextInstance++; i < numInstances; i = nextInstance++)
+					processInstance(instances[static_cast<size_t>(i)], *cycle);
+
+				std::lock_guard<std::mutex> lock(mutex);
+				if (++workersDone == static_cast<int>(workers.size()))
+					done.notify_one();
+			}
+		}
+	};
+
+	// Another thread moving parameters and saving the state, like a UI or a host's autosave
+	void poke(std::vector<Instance>& instances, std::atomic<bool>& running, int64 seed) {
+		Random random(seed);
+		while (running) {
+			auto& instance = instances[static_cast<size_t>(random.nextInt(static_cast<int>(instances.size())))];
+			auto* parameter = instance.parameters[random.nextInt(StateFormat::numParameters)];
+			parameter->setValueNotifyingHost(random.nextFloat());
+
+			if (random.nextInt(100) == 0) {
+				MemoryBlock state;
+				instance.processor->getStateInformation(state);
+			}
+			Thread::sleep(1 + random.nextInt(5));
+		}
+	}
+
+	struct Results {
+		int64 cycles = 0;
+		int64 deadlineMisses = 0;
+		double worstCycleNs = 0.0;
+		double worstCycleLoad = 0.0;
+		double worstCycleSeconds = 0.0;
+		double totalLoad = 0.0;
+		int prepares = 0;
+	};
+
+	class Simulation {
+	public:
+		Simulation(std::vector<Instance>& simInstances, int numThreads)
+			: instances(simInstances), graph(simInstances, numThreads) {
+			for (auto& instance : instances)
+				instance.processor->setPlayHead(&playHead);
+			clearAutomation();
+		}
+
+		~Simulation() {
+			for (auto& instance : instances)
+				instance.processor->setPlayHead(nullptr);
+		}
+
+		String run(const std::vector<Command>& commands) {
+			size_t nextCommand = 0;
+			double seconds = 0.0;
+			int blockIndex = 0;
+			bool ended = false;
+
+			while (!ended) {
+				cycle.program = -1;
+				for (; nextCommand < commands.size() && commands[nextCommand].time <= seconds; ++nextCommand) {
+					const auto error = apply(commands[nextCommand].tokens, ended);
+					if (error.isNotEmpty())
+						return "at " + String(commands[nextCommand].time) + " s: " + error;
+				}
+				if (ended)
+					break;
+				if (!isPrepared)
+					prepare();
+
+				cycle.blockSize = nextBlockSize(blockIndex++);
+				cycle.sampleRate = sampleRate;
+				cycle.deadlineNs = cycle.blockSize * 1.0e9 / sampleRate;
+				cycle.startSeconds = seconds;
+				for (int i = 0; i < StateFormat::numParameters; ++i) {
+					if (sweeps[i].periodSeconds > 0.0) {
+						cycle.automation[i] = sweeps[i].valueAt(seconds);
+						cycle.automationSlope[i] = (sweeps[i].valueAt(seconds + 1.0 / sampleRate) - cycle.automation[i]);
+					}
+				}
+
+				const auto start = Time::getHighResolutionTicks();
+				graph.run(cycle);
+				const double ns = static_cast<double>(Time::getHighResolutionTicks() - start) * 1.0e9
+					/ static_cast<double>(Time::getHighResolutionTicksPerSecond());
+
+				const double load = ns / cycle.deadlineNs;
+				++results.cycles;
+				results.totalLoad += load;
+				if (load > 1.0)
+					++results.deadlineMisses;
+				if (ns > results.worstCycleNs) {
+					results.worstCycleNs = ns;
+					results.worstCycleLoad = load;
+					results.worstCycleSeconds = seconds;
+				}
+
+				playHead.advance(cycle.blockSize);
+				seconds += cycle.blockSize / sampleRate;
+			}
+
+			onMessageThread([this] {
+				for (auto& instance : instances)
+					instance.processor->releaseResources();
+			});
+			return {};
+		}
+
+		const Results& getResults() const { return results; }
+
+	private:
+		struct Sweep {
+			float from = 0.0f, to = 0.0f;
+			double periodSeconds = 0.0;
+
+			float valueAt(double seconds) const {
+				const double phase = std::fmod(seconds / periodSeconds, 1.0);
+				const double triangle = phase < 0.5 ? phase * 2.0 : 2.0 - phase * 2.0;
+				return from + (to - from) * static_cast<float>(triangle);
+			}
+		};
+
+		std::vector<Instance>& instances;
+		Graph graph;
+		SimulatedPlayHead playHead;
+		Cycle cycle;
+		Sweep sweeps[StateFormat::numParameters];
+		Results results;
+		Random random { 1 };
+
+		double sampleRate = 48000.0;
+		std::vector<int> blockSizes { 256 };
+		int randomMin = 0, randomMax = 0;
+		bool isPrepared = false;
+
+		void clearAutomation() {
+			for (int i = 0; i < StateFormat::numParameters; ++i) {
+				cycle.automation[i] = std::numeric_limits<float>::quiet_NaN();
+				cycle.automationSlope[i] = 0.0f;
+				sweeps[i] = {};
+			}
+		}
+
+		int maxBlockSize() const {
+			int size = randomMax;
+			for (auto block : blockSizes)
+				size = jmax(size, block);
+			return jmax(1, size);
+		}
+
+		int nextBlockSize(int index) {
+			if (randomMax > 0)
+				return randomMin + random.nextInt(randomMax - randomMin + 1);
+			return blockSizes[static_cast<size_t>(index) % blockSizes.size()];
+		}
+
+		// Hosts prepare on the message thread, where the processor's own updates run too
+		template <typename Fn>
+		static void onMessageThread(Fn&& fn) {
+			WaitableEvent finished;
+			MessageManager::callAsync([&] {
+				fn();
+				finished.signal();
+			});
+			finished.wait();
+		}
+
+		// As a host does with the audio stopped
+		void prepare() {
+			onMessageThread([this] {
+				for (auto& instance : instances) {
+					instance.processor->releaseResources();
+					instance.processor->setRateAndBufferSizeDetails(sampleRate, maxBlockSize());
+					instance.processor->prepareToPlay(sampleRate, maxBlockSize());
+					instance.buffer.setSize(instance.processor->getTotalNumOutputChannels(), maxBlockSize());
+				}
+			});
+			playHead.sampleRate = sampleRate;
+			isPrepared = true;
+			++results.prepares;
+		}
+
+		String apply(const StringArray& tokens, bool& ended) {
+			const auto& name = tokens[0];
+			auto number = [&tokens] (int index) { return tokens[index].getDoubleValue(); };
+
+			if (name == "end") {
+				ended = true;
+			}
+			else if (name == "rate" && tokens.size() == 2 && number(1) > 0.0) {
+				sampleRate = number(1);
+				isPrepared = false;
+			}
+			else if (name == "reprepare") {
+				isPrepared = false;
+			}
+			else if (name == "blocks" && tokens.size() == 4 && tokens[1] == "random") {
+				randomMin = jmax(1, static_cast<int>(number(2)));
+				randomMax = jmax(randomMin, static_cast<int>(number(3)));
+				blockSizes = { randomMax };
+				isPrepared = isPrepared && maxBlockSize() <= instances.front().buffer.getNumSamples();
+			}
+			else if (name == "blocks" && tokens.size() >= 2) {
+				randomMin = randomMax = 0;
+				blockSizes.clear();
+				for (int i = 1; i < tokens.size(); ++i)
+					blockSizes.push_back(jmax(1, static_cast<int>(number(i))));
+				isPrepared = isPrepared && maxBlockSize() <= instances.front().buffer.getNumSamples();
+			}
+			else if (name == "tempo" && tokens.size() == 2 && number(1) > 0.0) {
+				playHead.bpm = number(1);
+			}
+			else if (name == "play" || name == "stop") {
+				playHead.isPlaying = name == "play";
+			}
+			else if (name == "jump" && tokens.size() == 2) {
+				playHead.ppq = number(1);
+				playHead.timeInSamples = static_cast<int64>(number(1) * 60.0 / playHead.bpm * sampleRate);
+			}
+			else if (name == "loop" && tokens.size() == 2 && tokens[1] == "off") {
+				playHead.isLooping = false;
+			}
+			else if (name == "loop" && tokens.size() == 3 && number(2) > number(1)) {
+				playHead.isLooping = true;
+				playHead.loopStart = number(1);
+				playHead.loopEnd = number(2);
+			}
+			else if (name == "automate" && tokens.size() >= 3) {
+				int index = -1;
+				for (int i = 0; i < StateFormat::numParameters; ++i)
+					if (StateFormat::parameters[i]->name.equalsIgnoreCase(tokens[1]))
+						index = i;
+				if (index < 0)
+					return "unknown parameter " + tokens[1];
+
+				if (tokens[2] == "off") {
+					sweeps[index] = {};
+					cycle.automation[index] = std::numeric_limits<float>::quiet_NaN();
+				}
+				else if (tokens.size() == 5 && number(4) > 0.0) {
+					sweeps[index] = { static_cast<float>(number(2)), static_cast<float>(number(3)), number(4) };
+				}
+				else {
+					return "automate takes a parameter, two values and a period";
+				}
+			}
+			else if (name == "program" && tokens.size() == 2) {
+				cycle.program = static_cast<int>(number(1));
+			}
+			else {
+				return "cannot read \"" + tokens.joinIntoString(" ") + "\"";
+			}
+			return {};
+		}
+	};
+}
+
+int main(int argc, char* argv[]) {
+	ScopedJuceInitialiser_GUI juceInit;
+	ArgumentList args(argc, argv);
+
+	auto intOption = [&args] (const String& option, int fallback) {
+		return args.containsOption(option) ? args.getValueForOption(option).getIntValue() : fallback;
+	};
+
+	const int numInstances = jmax(1, intOption("--instances", 16));
+	const int numThreads = jmax(1, intOption("--threads", SystemStats::getNumCpus()));
+	const int numPokers = jmax(0, intOption("--pokers", 1));
+	const int seed = intOption("--seed", 1);
+	const File output = args.containsOption("--output")
+		? args.getFileForOption("--output")
+		: File::getCurrentWorkingDirectory().getChildFile("hostsim.json");
+
+	String scriptText = defaultScript;
+	if (args.containsOption("--script")) {
+		const auto scriptFile = args.getFileForOption("--script");
+		if (!scriptFile.existsAsFile()) {
+			std::cerr << "cannot read " << scriptFile.getFullPathName() << std::endl;
+			return 1;
+		}
+		scriptText = scriptFile.loadFileAsString();
+	}
+
+	std::vector<Command> commands;
+	String error;
+	if (!parseScript(scriptText, commands, error)) {
+		std::cerr << "script " << error << std::endl;
+		return 1;
+	}
+
+	// Every instance gets its own seed and a few programs to switch between
+	std::vector<Instance> instances(static_cast<size_t>(numInstances));
+	Random random(seed);
+	for (auto& instance : instances) {
+		instance.processor = std::make_unique<Humanizer>();
+		instance.processor->curveGen.seed = random.nextInt();
+		instance.random.setSeed(random.nextInt64());
+		for (int i = 0; i < StateFormat::numParameters; ++i)
+			instance.parameters[i] = instance.processor->apvts.getParameter(StateFormat::parameters[i]->name);
+
+		for (int program = 0; program < numPrograms; ++program) {
+			for (auto* parameter : instance.parameters)
+				parameter->setValueNotifyingHost(random.nextFloat());
+			instance.processor->curveGen.seed = random.nextInt();
+			instance.processor->storeProgram(program, "Program " + String(program + 1));
+		}
+	}
+
+	std::cout << numInstances << " instances on " << numThreads << " threads, " << numPokers << " pokers" << std::endl;
+
+	// The script runs on its own thread, so this one can deliver messages as a host's message thread does
+	Results results;
+	String runError;
+	std::atomic<bool> running { true };
+	std::vector<std::thread> pokers;
+	for (int i = 0; i < numPokers; ++i)
+		pokers.emplace_back([&, i] { poke(instances, running, seed + 1000 + i); });
+
+	std::thread host([&] {
+		{
+			Simulation simulation(instances, numThreads);
+			runError = simulation.run(commands);
+			results = simulation.getResults();
+		}
+		running = false;
+		MessageManager::callAsync([] { MessageManager::getInstance()->stopDispatchLoop(); });
+	});
+
+	MessageManager::getInstance()->runDispatchLoop();
+	host.join();
+	for (auto& poker : pokers)
+		poker.join();
+
+	if (runError.isNotEmpty()) {
+		std::cerr << "script " << runError << std::endl;
+		return 1;
+	}
+
+	// Totals over every instance
+	int64 blocks = 0, allocated = 0, blocksWithAllocations = 0, maxAllocations = 0, suspended = 0;
+	const Instance* worst = &instances.front();
+	Array<var> instanceResults;
+	for (auto& instance : instances) {
+		blocks += instance.blocks;
+		allocated += instance.allocations;
+		blocksWithAllocations += instance.blocksWithAllocations;
+		maxAllocations = jmax(maxAllocations, instance.maxAllocations);
+		suspended += instance.suspendedBlocks;
+		if (instance.worstNs > worst->worstNs)
+			worst = &instance;
+		instanceResults.add(instance.processor->profiler.toJson());
+	}
+
+	auto* worstBlock = new DynamicObject();
+	worstBlock->setProperty("instance", static_cast<int>(worst - instances.data()));
+	worstBlock->setProperty("ns", worst->worstNs);
+	worstBlock->setProperty("load", worst->worstLoad);
+	worstBlock->setProperty("blockSize", worst->worstBlockSize);
+	worstBlock->setProperty("atSeconds", worst->worstSeconds);
+
+	auto* root = new DynamicObject();
+	root->setProperty("version", 1);
+	root->setProperty("cpu", SystemStats::getCpuModel());
+	root->setProperty("instances", numInstances);
+	root->setProperty("threads", numThreads);
+	root->setProperty("pokers", numPokers);
+	root->setProperty("cycles", results.cycles);
+	root->setProperty("prepares", results.prepares);
+	root->setProperty("deadlineMisses", results.deadlineMisses);
+	root->setProperty("meanCycleLoad", results.cycles > 0 ? results.totalLoad / static_cast<double>(results.cycles) : 0.0);
+	root->setProperty("worstCycleNs", results.worstCycleNs);
+	root->setProperty("worstCycleLoad", results.worstCycleLoad);
+	root->setProperty("worstCycleAtSeconds", results.worstCycleSeconds);
+	root->setProperty("worstBlock", var(worstBlock));
+	root->setProperty("blocks", blocks);
+	root->setProperty("suspendedBlocks", suspended);
+	root->setProperty("allocations", allocated);
+	root->setProperty("allocationsPerBlock", blocks > 0 ? static_cast<double>(allocated) / static_cast<double>(blocks) : 0.0);
+	root->setProperty("blocksWithAllocations", blocksWithAllocations);
+	root->setProperty("maxAllocationsInABlock", maxAllocations);
+	root->setProperty("profiler", instanceResults);
+
+	std::cout << results.cycles << " cycles, " << results.deadlineMisses << " deadline misses, worst cycle "
+			  << results.worstCycleNs / 1000.0 << " us (" << results.worstCycleLoad * 100.0 << " % of its deadline)" << std::endl;
+	std::cout << "worst block " << worst->worstNs / 1000.0 << " us, " << worst->worstBlockSize << " samples at "
+			  << worst->worstSeconds << " s on instance " << (worst - instances.data()) << std::endl;
+	std::cout << allocated << " allocations in " << blocks << " blocks (" << blocksWithAllocations
+			  << " blocks allocated, at most " << maxAllocations << " in one)" << std::endl;
+
+	if (!output.replaceWithText(JSON::toString(var(root)))) {
+		std::cerr << "cannot write " << output.getFullPathName() << std::endl;
+		return 1;
+	}
+	std::cout << "results written to " << output.getFullPathName() << std::endl;
+
+	if (args.containsOption("--strict") && (allocated > 0 || results.deadlineMisses > 0))
+		return 1;
+	return 0;
+}
@@ -0,0 +1,24 @@
+// OfflinePlayHead.h
+#pragma once
+#include <JuceHeader.h>
+
+// Transport for headless tools: always playing at a fixed tempo, with the
+// position advanced by the caller before every processBlock.
+class OfflinePlayHead : public AudioPlayHead {
+public:
+	double bpm = 120.0;
+	double sampleRate = 44100.0;
+	int64 timeInSamples = 0;
+
+	Optional<PositionInfo> getPosition() const override {
+		PositionInfo info;
+		const double seconds = static_cast<double>(timeInSamples) / sampleRate;
+
+		info.setBpm(bpm);
+		info.setTimeInSamples(timeInSamples);
+		info.setTimeInSeconds(seconds);
+		info.setPpqPosition(seconds * bpm / 60.0);
+		info.setIsPlaying(true);
+		return info;
+	}
+};